@@ -54,7 +54,7 @@ ${CROSS_PREFIX}g++ -g -O3 -shared -fPIC -std=c++14 \
     src/dsp/moog_engine.c \
     -o build/dsp.so \
     -Isrc/dsp \
-    -lm
+    -lm -lpthread
 
 # Copy files to dist (use cat to avoid ExtFS deallocation issues with Docker)
 echo "Packaging..."
@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+# Build native development tools for RaffoSynth
+#
+# Compiles the DSP sources for the host machine (no cross-compiler or
+# Docker needed) so the engine can be rendered and benchmarked off-device.
+# Set CXX to pick a compiler, EXTRA_FLAGS for extra options
+# (e.g. EXTRA_FLAGS=-DMOOG_NO_SIMD).
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+REPO_ROOT="$(dirname "$SCRIPT_DIR")"
+CXX="${CXX:-g++}"
+
+cd "$REPO_ROOT"
+
+echo "=== Building RaffoSynth Tools ==="
+echo "Compiler: $CXX"
+
+mkdir -p build
+
+# Offline renderer / benchmark
+echo "Compiling moog_render..."
+$CXX -g -O3 -std=c++14 $EXTRA_FLAGS \
+    src/tools/moog_render.cpp \
+    src/dsp/moog_plugin.cpp \
+    src/dsp/moog_engine.c \
+    -o build/moog_render \
+    -Isrc/dsp \
+    -lm -lpthread
+
+echo ""
+echo "=== Build Complete ==="
+echo "Output: build/moog_render"
+echo ""
+echo "Usage:"
+echo "  ./build/moog_render --help"
@@ -0,0 +1,37 @@
+#!/usr/bin/env bash
+# Regression checks for RaffoSynth
+#
+# Builds the native tools, checks the filter coefficient table against the
+# exact computation, and renders every factory preset through the default
+# note script against the references in golden/. golden/ holds each
+# render's hash and band spectrum, not the raw audio, so the default check
+# is spectral: within a tolerance that absorbs compiler and CPU float
+# differences. --exact requires the hashes to match instead, which holds
+# only on the compiler and CPU the references were recorded with. The SNR
+# check needs the raw renders and cannot run against golden/.
+#
+# Usage:
+#   ./scripts/check.sh            run the checks, exit 1 on failure
+#   ./scripts/check.sh --exact    the same, but renders must be bit-exact
+#   ./scripts/check.sh --update   re-record golden/ after an intended change
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+REPO_ROOT="$(dirname "$SCRIPT_DIR")"
+GOLDEN_DIR="golden"
+SPECTRAL_DB="${SPECTRAL_DB:-0.5}"
+
+cd "$REPO_ROOT"
+
+./scripts/build_tools.sh > /dev/null
+
+./build/moog_render --filter-check
+
+if [ "$1" = "--update" ]; then
+    ./build/moog_render -r 1 --golden-write "$GOLDEN_DIR"
+    rm -f "$GOLDEN_DIR"/*.raw
+elif [ "$1" = "--exact" ]; then
+    ./build/moog_render -r 1 --golden-check "$GOLDEN_DIR"
+else
+    ./build/moog_render -r 1 --golden-check "$GOLDEN_DIR" --spectral "$SPECTRAL_DB"
+fi
@@ -6,7 +6,7 @@
  * MIT License
  *
  * Ported from LV2 to standalone C for Move Anything.
- * Monophonic synthesizer with:
+ * Monophonic (or polyphonic voice pool) synthesizer with:
  *   - 4 oscillators (triangle, sawtooth, square, pulse)
  *   - Moog-style ladder filter (low-pass with resonance)
  *   - Amplitude ADSR envelope
@@ -54,60 +54,635 @@ static inline double param_to_time(float param, float sample_rate) {
     return seconds * sample_rate;
 }
 
+/* Fast 2^x for modulation paths (Cephes exp2f polynomial, ~1e-6 rel. error) */
+static inline float fast_exp2f(float x) {
+    if (x < -126.0f) x = -126.0f;
+    if (x > 126.0f) x = 126.0f;
+
+    float xi = floorf(x + 0.5f);
+    float f = x - xi;
+
+    float p = 1.535336188319500e-4f;
+    p = p * f + 1.339887440266574e-3f;
+    p = p * f + 9.618437357674640e-3f;
+    p = p * f + 5.550332471162809e-2f;
+    p = p * f + 2.402264791363012e-1f;
+    p = p * f + 6.931472028550421e-1f;
+    p = p * f + 1.0f;
+
+    /* Scale by 2^xi via the exponent bits */
+    union { float f; uint32_t i; } u;
+    u.f = p;
+    u.i += (uint32_t)(int32_t)xi << 23;
+    return u.f;
+}
+
+/* log2(1000): maps normalized cutoff to 20Hz - 20kHz */
+#define LOG2_1000 9.965784284662087f
+
 /* Simple white noise generator (LFSR) */
 static inline float noise_sample(uint32_t *seed) {
     *seed = *seed * 1664525u + 1013904223u;
     return (float)(int32_t)(*seed) / (float)0x7FFFFFFF;
 }
 
+/* ===================================================================
+ * Denormal handling
+ * Decaying filter, resampler and envelope state would otherwise crawl
+ * through the denormal range, which costs tens of cycles per operation
+ * on many cores. Render runs with flush-to-zero (AArch64 FPCR.FZ, x86
+ * MXCSR FTZ|DAZ) and restores the caller's mode afterwards; state that
+ * lives across calls is also snapped to zero below MOOG_DENORMAL_SNAP.
+ * Define MOOG_NO_FTZ to leave the FP mode alone (for A/B benchmarks).
+ * =================================================================== */
+
+#define MOOG_DENORMAL_SNAP 1e-15f
+
+static inline float snap_denormal(float x) {
+    return (fabsf(x) < MOOG_DENORMAL_SNAP) ? 0.0f : x;
+}
+
+#if !defined(MOOG_NO_FTZ) && defined(__aarch64__)
+#define FPCR_FZ (1ull << 24)
+
+typedef uint64_t fp_mode_t;
+
+static inline fp_mode_t fp_mode_enter(void) {
+    uint64_t fpcr;
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+    if (!(fpcr & FPCR_FZ)) __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | FPCR_FZ));
+    return fpcr;
+}
+
+static inline void fp_mode_leave(fp_mode_t fpcr) {
+    if (!(fpcr & FPCR_FZ)) __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+}
+
+#elif !defined(MOOG_NO_FTZ) && (defined(__SSE__) || defined(_M_X64))
+#include <xmmintrin.h>
+#define MXCSR_FTZ_DAZ 0x8040u     /* FTZ bit 15, DAZ bit 6 */
+
+typedef unsigned int fp_mode_t;
+
+static inline fp_mode_t fp_mode_enter(void) {
+    unsigned int csr = _mm_getcsr();
+    if ((csr & MXCSR_FTZ_DAZ) != MXCSR_FTZ_DAZ) _mm_setcsr(csr | MXCSR_FTZ_DAZ);
+    return csr;
+}
+
+static inline void fp_mode_leave(fp_mode_t csr) {
+    if ((csr & MXCSR_FTZ_DAZ) != MXCSR_FTZ_DAZ) _mm_setcsr(csr);
+}
+
+#else
+typedef int fp_mode_t;
+
+static inline fp_mode_t fp_mode_enter(void) { return 0; }
+static inline void fp_mode_leave(fp_mode_t mode) { (void)mode; }
+#endif
+
+/* ===================================================================
+ * 4-lane float vectors (one lane per oscillator, or per voice)
+ * NEON on the Move's AArch64 cores, SSE2 on x86 hosts, plain C
+ * otherwise. Define MOOG_NO_SIMD to force the plain C lanes, which
+ * are correct but slower than the per-oscillator scalar code.
+ * =================================================================== */
+
+#if !defined(MOOG_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define MOOG_SIMD 1
+
+typedef float32x4_t v4f;
+typedef uint32x4_t v4m;
+
+static inline v4f v4f_load(const float *p) { return vld1q_f32(p); }
+static inline void v4f_store(float *p, v4f a) { vst1q_f32(p, a); }
+static inline v4f v4f_set1(float x) { return vdupq_n_f32(x); }
+static inline v4f v4f_add(v4f a, v4f b) { return vaddq_f32(a, b); }
+static inline v4f v4f_sub(v4f a, v4f b) { return vsubq_f32(a, b); }
+static inline v4f v4f_mul(v4f a, v4f b) { return vmulq_f32(a, b); }
+static inline v4f v4f_min(v4f a, v4f b) { return vminq_f32(a, b); }
+static inline v4f v4f_max(v4f a, v4f b) { return vmaxq_f32(a, b); }
+static inline v4f v4f_abs(v4f a) { return vabsq_f32(a); }
+static inline v4m v4m_load(const uint32_t *p) { return vld1q_u32(p); }
+static inline v4m v4f_lt(v4f a, v4f b) { return vcltq_f32(a, b); }
+static inline v4m v4f_gt(v4f a, v4f b) { return vcgtq_f32(a, b); }
+static inline v4m v4f_ge(v4f a, v4f b) { return vcgeq_f32(a, b); }
+static inline v4f v4f_select(v4m m, v4f a, v4f b) { return vbslq_f32(m, a, b); }
+static inline v4f v4f_and(v4m m, v4f a) {
+    return vreinterpretq_f32_u32(vandq_u32(m, vreinterpretq_u32_f32(a)));
+}
+static inline v4f v4f_recip(v4f a) {
+    /* Estimate plus two Newton-Raphson steps (~full float precision) */
+    v4f r = vrecpeq_f32(a);
+    r = vmulq_f32(r, vrecpsq_f32(a, r));
+    return vmulq_f32(r, vrecpsq_f32(a, r));
+}
+static inline float v4f_hsum(v4f a) {
+#if defined(__aarch64__)
+    return vaddvq_f32(a);
+#else
+    float32x2_t s = vadd_f32(vget_low_f32(a), vget_high_f32(a));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+#endif
+}
+
+#elif !defined(MOOG_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define MOOG_SIMD 1
+
+typedef __m128 v4f;
+typedef __m128 v4m;
+
+static inline v4f v4f_load(const float *p) { return _mm_loadu_ps(p); }
+static inline void v4f_store(float *p, v4f a) { _mm_storeu_ps(p, a); }
+static inline v4f v4f_set1(float x) { return _mm_set1_ps(x); }
+static inline v4f v4f_add(v4f a, v4f b) { return _mm_add_ps(a, b); }
+static inline v4f v4f_sub(v4f a, v4f b) { return _mm_sub_ps(a, b); }
+static inline v4f v4f_mul(v4f a, v4f b) { return _mm_mul_ps(a, b); }
+static inline v4f v4f_min(v4f a, v4f b) { return _mm_min_ps(a, b); }
+static inline v4f v4f_max(v4f a, v4f b) { return _mm_max_ps(a, b); }
+static inline v4f v4f_abs(v4f a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+static inline v4m v4m_load(const uint32_t *p) {
+    return _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)p));
+}
+static inline v4m v4f_lt(v4f a, v4f b) { return _mm_cmplt_ps(a, b); }
+static inline v4m v4f_gt(v4f a, v4f b) { return _mm_cmpgt_ps(a, b); }
+static inline v4m v4f_ge(v4f a, v4f b) { return _mm_cmpge_ps(a, b); }
+static inline v4f v4f_select(v4m m, v4f a, v4f b) {
+    return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+static inline v4f v4f_and(v4m m, v4f a) { return _mm_and_ps(m, a); }
+static inline v4f v4f_recip(v4f a) { return _mm_div_ps(_mm_set1_ps(1.0f), a); }
+static inline float v4f_hsum(v4f a) {
+    __m128 s = _mm_add_ps(a, _mm_movehl_ps(a, a));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+#else
+#define MOOG_SIMD 0
+
+typedef struct { float v[4]; } v4f;
+typedef struct { uint32_t v[4]; } v4m;
+
+#define V4_MAP(expr) do { for (int l_ = 0; l_ < 4; l_++) { expr; } } while (0)
+
+static inline v4f v4f_load(const float *p) { v4f r; V4_MAP(r.v[l_] = p[l_]); return r; }
+static inline void v4f_store(float *p, v4f a) { V4_MAP(p[l_] = a.v[l_]); }
+static inline v4f v4f_set1(float x) { v4f r; V4_MAP(r.v[l_] = x); return r; }
+static inline v4f v4f_add(v4f a, v4f b) { V4_MAP(a.v[l_] += b.v[l_]); return a; }
+static inline v4f v4f_sub(v4f a, v4f b) { V4_MAP(a.v[l_] -= b.v[l_]); return a; }
+static inline v4f v4f_mul(v4f a, v4f b) { V4_MAP(a.v[l_] *= b.v[l_]); return a; }
+static inline v4f v4f_min(v4f a, v4f b) {
+    V4_MAP(a.v[l_] = (b.v[l_] < a.v[l_]) ? b.v[l_] : a.v[l_]); return a;
+}
+static inline v4f v4f_max(v4f a, v4f b) {
+    V4_MAP(a.v[l_] = (b.v[l_] > a.v[l_]) ? b.v[l_] : a.v[l_]); return a;
+}
+static inline v4f v4f_abs(v4f a) { V4_MAP(a.v[l_] = fabsf(a.v[l_])); return a; }
+static inline v4m v4m_load(const uint32_t *p) { v4m r; V4_MAP(r.v[l_] = p[l_]); return r; }
+static inline v4m v4f_lt(v4f a, v4f b) {
+    v4m r; V4_MAP(r.v[l_] = (a.v[l_] < b.v[l_]) ? 0xFFFFFFFFu : 0u); return r;
+}
+static inline v4m v4f_gt(v4f a, v4f b) {
+    v4m r; V4_MAP(r.v[l_] = (a.v[l_] > b.v[l_]) ? 0xFFFFFFFFu : 0u); return r;
+}
+static inline v4m v4f_ge(v4f a, v4f b) {
+    v4m r; V4_MAP(r.v[l_] = (a.v[l_] >= b.v[l_]) ? 0xFFFFFFFFu : 0u); return r;
+}
+static inline v4f v4f_select(v4m m, v4f a, v4f b) {
+    V4_MAP(a.v[l_] = m.v[l_] ? a.v[l_] : b.v[l_]); return a;
+}
+static inline v4f v4f_and(v4m m, v4f a) { V4_MAP(a.v[l_] = m.v[l_] ? a.v[l_] : 0.0f); return a; }
+static inline v4f v4f_recip(v4f a) { V4_MAP(a.v[l_] = 1.0f / a.v[l_]); return a; }
+static inline float v4f_hsum(v4f a) { return (a.v[0] + a.v[1]) + (a.v[2] + a.v[3]); }
+
+#undef V4_MAP
+#endif
+
+/* Wrap 0.0 - 2.0 back into 0.0 - 1.0 */
+static inline v4f v4f_wrap(v4f p) {
+    v4f one = v4f_set1(1.0f);
+    return v4f_sub(p, v4f_and(v4f_ge(p, one), one));
+}
+
 /* ===================================================================
  * Oscillator waveform generators
  * Based on oscillators.c from RaffoSynth
  * =================================================================== */
 
-static inline float osc_triangle(double counter, double period) {
-    double phase = fmod(counter + period / 4.0, period) / period;
-    return 4.0f * (float)(fabs(phase - 0.5) - 0.25);
+static inline float osc_triangle(float phase) {
+    float p = phase + 0.25f;
+    if (p >= 1.0f) p -= 1.0f;
+    return 4.0f * (fabsf(p - 0.5f) - 0.25f);
 }
 
-static inline float osc_sawtooth(double counter, double period) {
-    return 2.0f * (float)(fmod(counter, period) / period) - 1.0f;
+static inline float osc_sawtooth(float phase) {
+    return 2.0f * phase - 1.0f;
 }
 
-static inline float osc_square(double counter, double period) {
-    return (fmod(counter, period) / period < 0.5) ? 1.0f : -1.0f;
+static inline float osc_square(float phase) {
+    return (phase < 0.5f) ? 1.0f : -1.0f;
 }
 
-static inline float osc_pulse(double counter, double period) {
-    return (fmod(counter, period) / period < 0.2) ? 1.0f : -1.0f;
+static inline float osc_pulse(float phase) {
+    return (phase < 0.2f) ? 1.0f : -1.0f;
 }
 
-static float generate_osc(moog_wave_t wave, double counter, double period) {
+static float generate_osc(moog_wave_t wave, float phase) {
     switch (wave) {
-        case WAVE_TRIANGLE: return osc_triangle(counter, period);
-        case WAVE_SAWTOOTH: return osc_sawtooth(counter, period);
-        case WAVE_SQUARE:   return osc_square(counter, period);
-        case WAVE_PULSE:    return osc_pulse(counter, period);
+        case WAVE_TRIANGLE: return osc_triangle(phase);
+        case WAVE_SAWTOOTH: return osc_sawtooth(phase);
+        case WAVE_SQUARE:   return osc_square(phase);
+        case WAVE_PULSE:    return osc_pulse(phase);
         default:            return 0.0f;
     }
 }
 
+/* ===================================================================
+ * Band-limited oscillators
+ * PolyBLEP corrects each step discontinuity with a 2-sample polynomial
+ * residual; PolyBLAMP (its integral) rounds the triangle corners.
+ * =================================================================== */
+
+/* Residual for a step of height 2 at phase 0 (dt = phase increment) */
+static inline float poly_blep(float t, float dt) {
+    if (t < dt) {
+        t /= dt;
+        return t + t - t * t - 1.0f;
+    }
+    if (t > 1.0f - dt) {
+        t = (t - 1.0f) / dt;
+        return t * t + t + t + 1.0f;
+    }
+    return 0.0f;
+}
+
+/* Residual for a unit slope change (per sample) at phase 0 */
+static inline float poly_blamp(float t, float dt) {
+    if (t < dt) {
+        t = 1.0f - t / dt;
+        return t * t * t * (1.0f / 6.0f);
+    }
+    if (t > 1.0f - dt) {
+        t = (t - 1.0f) / dt + 1.0f;
+        return t * t * t * (1.0f / 6.0f);
+    }
+    return 0.0f;
+}
+
+/* Wrap a phase offset back into 0.0 - 1.0 */
+static inline float phase_offset(float phase, float offset) {
+    float p = phase + offset;
+    return (p >= 1.0f) ? p - 1.0f : p;
+}
+
+static float generate_osc_blep(moog_wave_t wave, float phase, float dt) {
+    switch (wave) {
+        case WAVE_TRIANGLE:
+            /* Slope changes by +/-8 per cycle at phase 0.25 and 0.75 */
+            return osc_triangle(phase)
+                 + 8.0f * dt * (poly_blamp(phase_offset(phase, 0.75f), dt)
+                              - poly_blamp(phase_offset(phase, 0.25f), dt));
+        case WAVE_SAWTOOTH:
+            return osc_sawtooth(phase) - poly_blep(phase, dt);
+        case WAVE_SQUARE:
+            return osc_square(phase) + poly_blep(phase, dt)
+                 - poly_blep(phase_offset(phase, 0.5f), dt);
+        case WAVE_PULSE:
+            return osc_pulse(phase) + poly_blep(phase, dt)
+                 - poly_blep(phase_offset(phase, 0.8f), dt);
+        default:
+            return 0.0f;
+    }
+}
+
+/* ===================================================================
+ * Wavetable oscillators
+ * Per-octave band-limited tables, shared read-only by all engines.
+ * Level L holds harmonics up to (MOOG_WT_SIZE / 2) >> L, so a level is
+ * alias-free for any increment up to 2^L / (2 * MOOG_WT_SIZE).
+ * =================================================================== */
+
+static float g_wavetables[WAVE_COUNT][MOOG_WT_LEVELS][MOOG_WT_SIZE + 1];
+static int g_tables_ready = 0;
+
+/* Fourier coefficients of the naive shapes (sin and cos terms) */
+static void wave_harmonic(moog_wave_t wave, int k, double *b, double *a) {
+    double pulse_width = 0.5;
+
+    *a = 0.0;
+    *b = 0.0;
+    switch (wave) {
+        case WAVE_TRIANGLE:
+            /* Odd harmonics, 1/k^2, starting downwards at phase 0 */
+            if (k & 1) {
+                double sign = ((k >> 1) & 1) ? 1.0 : -1.0;
+                *b = sign * 8.0 / (M_PI * M_PI * k * k);
+            }
+            return;
+        case WAVE_SAWTOOTH:
+            *b = -2.0 / (M_PI * k);
+            return;
+        case WAVE_PULSE:
+            pulse_width = 0.2;
+            /* fall through */
+        case WAVE_SQUARE:
+            *b = 2.0 * (1.0 - cos(2.0 * M_PI * k * pulse_width)) / (M_PI * k);
+            *a = 2.0 * sin(2.0 * M_PI * k * pulse_width) / (M_PI * k);
+            return;
+        default:
+            return;
+    }
+}
+
+static void build_wavetable(moog_wave_t wave, const double *sintab, double *acc) {
+    const int mask = MOOG_WT_SIZE - 1;
+    const int quarter = MOOG_WT_SIZE / 4;
+
+    /* DC offset of the pulse shapes */
+    double dc = 0.0;
+    if (wave == WAVE_PULSE) dc = 2.0 * 0.2 - 1.0;
+    for (int n = 0; n < MOOG_WT_SIZE; n++) acc[n] = dc;
+
+    /* Walk from the sparsest level down, adding harmonics as we go */
+    int k = 1;
+    for (int level = MOOG_WT_LEVELS - 1; level >= 0; level--) {
+        int max_harmonic = (MOOG_WT_SIZE / 2) >> level;
+        if (max_harmonic >= MOOG_WT_SIZE / 2) max_harmonic = MOOG_WT_SIZE / 2 - 1;
+
+        for (; k <= max_harmonic; k++) {
+            double b, a;
+            wave_harmonic(wave, k, &b, &a);
+            if (b == 0.0 && a == 0.0) continue;
+            for (int n = 0; n < MOOG_WT_SIZE; n++) {
+                int idx = (k * n) & mask;
+                acc[n] += b * sintab[idx] + a * sintab[(idx + quarter) & mask];
+            }
+        }
+
+        float *table = g_wavetables[wave][level];
+        for (int n = 0; n < MOOG_WT_SIZE; n++) table[n] = (float)acc[n];
+        table[MOOG_WT_SIZE] = table[0];  /* Guard point for interpolation */
+    }
+}
+
+/* Smallest level whose top harmonic stays below Nyquist:
+ * ceil(log2(inc * MOOG_WT_SIZE)), read straight from the float bits */
+static inline int wavetable_level(float inc) {
+    union { float f; uint32_t i; } u;
+    u.f = inc * (float)MOOG_WT_SIZE;
+    int level = (int)((u.i >> 23) & 0xFF) - 127 + ((u.i & 0x7FFFFF) != 0);
+    if (level < 0) level = 0;
+    if (level > MOOG_WT_LEVELS - 1) level = MOOG_WT_LEVELS - 1;
+    return level;
+}
+
+static inline float generate_osc_wavetable(moog_wave_t wave, float phase, float inc) {
+    const float *table = g_wavetables[wave][wavetable_level(inc)];
+    float pos = phase * (float)MOOG_WT_SIZE;
+    int idx = (int)pos;
+    float frac = pos - (float)idx;
+    return table[idx] + (table[idx + 1] - table[idx]) * frac;
+}
+
+/* ===================================================================
+ * Vector oscillator bank
+ * All four oscillators run in one 4-lane pass. Every waveform is
+ * described by per-lane constants, so the shape is picked with select
+ * masks instead of a switch:
+ *   naive  = triangle | sawtooth | pulse(width)     (square = width 0.5)
+ *   blep   = step0 * blep(t0) + step1 * blep(t1)
+ *          + dt * (slope0 * blamp(t0) + slope1 * blamp(t1))
+ * where t0/t1 are the phase relative to the waveform's two corners.
+ * =================================================================== */
+
+typedef struct {
+    float ratio[4];
+    float volume[4];
+    float width[4];
+    float corner0[4], corner1[4];   /* Phase offsets so t = 0 at a corner */
+    float step0[4], step1[4];       /* Step heights / 2 */
+    float slope0[4], slope1[4];     /* Slope changes per cycle */
+    uint32_t is_triangle[4];
+    uint32_t is_sawtooth[4];
+    int wave_ok[4];
+} osc_lanes_t;
+
+static void osc_lanes_setup(const moog_engine_t *engine, osc_lanes_t *l) {
+    memset(l, 0, sizeof(*l));
+    for (int osc = 0; osc < 4; osc++) {
+        l->ratio[osc] = engine->osc_ratio[osc];
+        l->width[osc] = 0.5f;
+        l->wave_ok[osc] = 1;
+
+        switch (engine->osc_wave[osc]) {
+            case WAVE_TRIANGLE:
+                l->is_triangle[osc] = 0xFFFFFFFFu;
+                l->corner0[osc] = 0.75f;
+                l->corner1[osc] = 0.25f;
+                l->slope0[osc] = 8.0f;
+                l->slope1[osc] = -8.0f;
+                break;
+            case WAVE_SAWTOOTH:
+                l->is_sawtooth[osc] = 0xFFFFFFFFu;
+                l->step0[osc] = -1.0f;
+                break;
+            case WAVE_PULSE:
+                l->width[osc] = 0.2f;
+                /* fall through */
+            case WAVE_SQUARE:
+                l->corner1[osc] = 1.0f - l->width[osc];
+                l->step0[osc] = 1.0f;
+                l->step1[osc] = -1.0f;
+                break;
+            default:
+                l->wave_ok[osc] = 0;
+                break;
+        }
+    }
+}
+
+/* Lane volumes for one control tick; near-silent oscillators are muted */
+static inline void osc_lanes_volume(osc_lanes_t *l, const float *volume) {
+    for (int osc = 0; osc < 4; osc++) {
+        l->volume[osc] = (l->wave_ok[osc] && volume[osc] >= 0.001f) ? volume[osc] : 0.0f;
+    }
+}
+
+/* Copy oscillator osc of src into one lane of dst, for running an
+ * oscillator across four voices or four engines */
+static void osc_lanes_copy(const osc_lanes_t *src, int osc, osc_lanes_t *dst, int lane) {
+    dst->ratio[lane] = src->ratio[osc];
+    dst->volume[lane] = src->volume[osc];
+    dst->width[lane] = src->width[osc];
+    dst->corner0[lane] = src->corner0[osc];
+    dst->corner1[lane] = src->corner1[osc];
+    dst->step0[lane] = src->step0[osc];
+    dst->step1[lane] = src->step1[osc];
+    dst->slope0[lane] = src->slope0[osc];
+    dst->slope1[lane] = src->slope1[osc];
+    dst->is_triangle[lane] = src->is_triangle[osc];
+    dst->is_sawtooth[lane] = src->is_sawtooth[osc];
+    dst->wave_ok[lane] = src->wave_ok[osc];
+}
+
+/* PolyBLEP and PolyBLAMP residuals at t (see poly_blep / poly_blamp) */
+static inline void v4f_blep_blamp(v4f t, v4f dt, v4f inv_dt, v4f *blep, v4f *blamp) {
+    v4f one = v4f_set1(1.0f);
+    v4f a = v4f_and(v4f_lt(t, dt), v4f_sub(one, v4f_mul(t, inv_dt)));
+    v4f b = v4f_and(v4f_gt(t, v4f_sub(one, dt)),
+                    v4f_sub(one, v4f_mul(v4f_sub(one, t), inv_dt)));
+    v4f a2 = v4f_mul(a, a);
+    v4f b2 = v4f_mul(b, b);
+    *blep = v4f_sub(b2, a2);
+    *blamp = v4f_mul(v4f_add(v4f_mul(a2, a), v4f_mul(b2, b)), v4f_set1(1.0f / 6.0f));
+}
+
+/* Lane waveforms at phase p (before volume) */
+static inline v4f osc_lanes_shape(const osc_lanes_t *l, v4f p, v4f inc, int band_limited) {
+    v4f one = v4f_set1(1.0f);
+
+    v4f tri = v4f_wrap(v4f_add(p, v4f_set1(0.25f)));
+    tri = v4f_mul(v4f_set1(4.0f), v4f_sub(v4f_abs(v4f_sub(tri, v4f_set1(0.5f))), v4f_set1(0.25f)));
+    v4f saw = v4f_sub(v4f_add(p, p), one);
+    v4f pulse = v4f_select(v4f_lt(p, v4f_load(l->width)), one, v4f_set1(-1.0f));
+    v4f out = v4f_select(v4m_load(l->is_triangle), tri,
+                         v4f_select(v4m_load(l->is_sawtooth), saw, pulse));
+
+    if (band_limited) {
+        v4f inv_dt = v4f_recip(inc);
+        v4f blep0, blamp0, blep1, blamp1;
+        v4f_blep_blamp(v4f_wrap(v4f_add(p, v4f_load(l->corner0))), inc, inv_dt, &blep0, &blamp0);
+        v4f_blep_blamp(v4f_wrap(v4f_add(p, v4f_load(l->corner1))), inc, inv_dt, &blep1, &blamp1);
+
+        out = v4f_add(out, v4f_add(v4f_mul(v4f_load(l->step0), blep0),
+                                   v4f_mul(v4f_load(l->step1), blep1)));
+        out = v4f_add(out, v4f_mul(inc, v4f_add(v4f_mul(v4f_load(l->slope0), blamp0),
+                                                v4f_mul(v4f_load(l->slope1), blamp1))));
+    }
+    return out;
+}
+
+/* One sample of all four oscillators; advances the phases */
+static inline float osc_lanes_tick(const osc_lanes_t *l, v4f *phase, v4f *inc_out,
+                                   float base_inc, int band_limited) {
+    v4f p = *phase;
+
+    /* Oscillator period never drops below 2 samples */
+    v4f inc = v4f_min(v4f_mul(v4f_set1(base_inc), v4f_load(l->ratio)), v4f_set1(0.5f));
+    v4f out = osc_lanes_shape(l, p, inc, band_limited);
+
+    *phase = v4f_wrap(v4f_add(p, inc));
+    *inc_out = inc;
+    return v4f_hsum(v4f_mul(out, v4f_load(l->volume)));
+}
+
 /* ===================================================================
  * Moog ladder filter
  * Based on equalizer.c from RaffoSynth, enhanced with proper
  * Moog-style 4-pole ladder resonance
  * =================================================================== */
 
-static void moog_filter_process(float *output, float *prev, int frames,
-                                float cutoff_hz, float resonance,
-                                float sample_rate) {
-    /* Compute filter coefficients for 4-pole Moog ladder filter */
+/* Ladder coefficients for one normalized cutoff value */
+typedef struct {
+    float f;        /* One-pole coefficient */
+    float gain;     /* Input gain 0.35013 * f^4 */
+    float fb_comp;  /* Resonance compensation: fb = resonance * fb_comp */
+    float pad;
+} filter_coef_t;
+
+static inline filter_coef_t filter_coef_exact(float cutoff_normalized, float sample_rate) {
+    filter_coef_t c;
+
+    /* Map normalized cutoff to Hz (exponential: 20Hz to 20kHz) */
+    float cutoff_hz = 20.0f * fast_exp2f(cutoff_normalized * LOG2_1000);
+
     float fc = cutoff_hz / sample_rate;
     if (fc > 0.49f) fc = 0.49f;
     if (fc < 0.001f) fc = 0.001f;
 
-    float f = fc * 1.16f;
-    float fb = resonance * (1.0f - 0.15f * f * f);
+    c.f = fc * 1.16f;
+    c.gain = 0.35013f * c.f * c.f * c.f * c.f;
+    c.fb_comp = 1.0f - 0.15f * c.f * c.f;
+    c.pad = 0.0f;
+    return c;
+}
+
+/* Coefficients at MOOG_SAMPLE_RATE times each oversampling factor, with a
+ * guard entry for interpolation */
+static filter_coef_t g_filter_table[MOOG_FILTER_OS_COUNT][MOOG_FILTER_TABLE_SIZE + 1];
+
+static void build_filter_table(void) {
+    for (int os = 0; os < MOOG_FILTER_OS_COUNT; os++) {
+        float sr = (float)(MOOG_SAMPLE_RATE << os);
+        for (int i = 0; i <= MOOG_FILTER_TABLE_SIZE; i++) {
+            g_filter_table[os][i] = filter_coef_exact((float)i / MOOG_FILTER_TABLE_SIZE, sr);
+        }
+    }
+}
+
+/* Linear interpolation in the table; cutoff must already be 0.0 - 1.0 */
+static inline filter_coef_t filter_coef_lookup(const filter_coef_t *table, float cutoff_normalized) {
+    float pos = cutoff_normalized * (float)MOOG_FILTER_TABLE_SIZE;
+    int idx = (int)pos;
+    if (idx > MOOG_FILTER_TABLE_SIZE - 1) idx = MOOG_FILTER_TABLE_SIZE - 1;
+    float frac = pos - (float)idx;
+
+    const filter_coef_t *a = &table[idx];
+    const filter_coef_t *b = a + 1;
+    filter_coef_t c;
+    c.f = a->f + (b->f - a->f) * frac;
+    c.gain = a->gain + (b->gain - a->gain) * frac;
+    c.fb_comp = a->fb_comp + (b->fb_comp - a->fb_comp) * frac;
+    c.pad = 0.0f;
+    return c;
+}
+
+void moog_engine_filter_table_error(int oversample, float resonance, int steps,
+                                    moog_filter_table_error_t *err) {
+    const filter_coef_t *table = g_filter_table[oversample];
+    float sr = (float)(MOOG_SAMPLE_RATE << oversample);
+    int count = MOOG_FILTER_TABLE_SIZE * steps;
+
+    err->f = err->gain = err->fb = 0.0f;
+    for (int i = 0; i <= count; i++) {
+        float cutoff = (float)i / (float)count;
+        filter_coef_t t = filter_coef_lookup(table, cutoff);
+        filter_coef_t x = filter_coef_exact(cutoff, sr);
+
+        float ef = fabsf(t.f - x.f) / x.f;
+        float eg = fabsf(t.gain - x.gain) / x.gain;
+        float eb = fabsf(t.fb_comp - x.fb_comp) * resonance;
+        if (ef > err->f) err->f = ef;
+        if (eg > err->gain) err->gain = eg;
+        if (eb > err->fb) err->fb = eb;
+    }
+}
+
+/* Soft knee for the last pole: linear up to 3.0, then approaching 4.0 */
+static inline float ladder_saturate(float x) {
+    float a = fabsf(x);
+    if (__builtin_expect(a <= 3.0f, 1)) return x;
+    float over = a - 3.0f;
+    float y = 3.0f + over / (1.0f + over);
+    return (x < 0.0f) ? -y : y;
+}
+
+/* 4-pole ladder over a block with the state held in registers.
+ * Coefficients ramp linearly from c0 to c1 across the block. soft_clip
+ * selects the saturating knee instead of the hard +-4 clamp. */
+static inline void moog_filter_process(float *output, float *prev, int frames,
+                                       filter_coef_t c0, filter_coef_t c1,
+                                       float resonance, int soft_clip) {
+    float inv = 1.0f / frames;
+    float f = c0.f;
+    float gain = c0.gain;
+    float fb_comp = c0.fb_comp;
+    float df = (c1.f - c0.f) * inv;
+    float dgain = (c1.gain - c0.gain) * inv;
+    float dfb_comp = (c1.fb_comp - c0.fb_comp) * inv;
 
     float b0 = prev[0];
     float b1 = prev[1];
@@ -116,18 +691,27 @@ static void moog_filter_process(float *output, float *prev, int frames,
     float b4 = prev[4];
 
     for (int i = 0; i < frames; i++) {
-        float input = output[i] - b4 * fb;
-        input *= 0.35013f * f * f * f * f;
+        f += df;
+        gain += dgain;
+        fb_comp += dfb_comp;
 
-        b1 = input + 0.3f * b0 + (1.0f - f) * b1;
+        float input = output[i] - b4 * resonance * fb_comp;
+        input *= gain;
+
+        float g = 1.0f - f;
+        b1 = input + 0.3f * b0 + g * b1;
         b0 = input;
-        b2 = b1 + 0.3f * b1 + (1.0f - f) * b2;
-        b3 = b2 + 0.3f * b2 + (1.0f - f) * b3;
-        b4 = b3 + 0.3f * b3 + (1.0f - f) * b4;
+        b2 = b1 + 0.3f * b1 + g * b2;
+        b3 = b2 + 0.3f * b2 + g * b3;
+        b4 = b3 + 0.3f * b3 + g * b4;
 
         /* Clamp to prevent blowup */
-        if (b4 > 4.0f) b4 = 4.0f;
-        if (b4 < -4.0f) b4 = -4.0f;
+        if (soft_clip) {
+            b4 = ladder_saturate(b4);
+        } else {
+            if (b4 > 4.0f) b4 = 4.0f;
+            if (b4 < -4.0f) b4 = -4.0f;
+        }
 
         output[i] = b4;
     }
@@ -139,75 +723,307 @@ static void moog_filter_process(float *output, float *prev, int frames,
     prev[4] = b4;
 }
 
+/* ===================================================================
+ * Half-band resampler for the oversampled ladder
+ * Polyphase 2x stages built from symmetric half-band FIRs: every other
+ * tap is zero and the centre tap is 0.5, so each output costs one
+ * multiply per coefficient pair. Kaiser-windowed sinc designs with
+ * ~70 dB rejection; the second (4x) stage only needs to guard the
+ * lower quarter of its band, so it gets away with half the taps.
+ * =================================================================== */
+
+#define HB1_TAPS 8
+#define HB2_TAPS 4
+
+#if 2 * HB1_TAPS > MOOG_HB_LEN
+#error "MOOG_HB_LEN too small for the half-band history"
+#endif
+
+static const float g_hb1_coef[HB1_TAPS] = {
+    0.628666887f, -0.189206450f, 0.092118101f, -0.047485099f,
+    0.023249686f, -0.010074930f, 0.003520599f, -0.000788795f
+};
+
+static const float g_hb2_coef[HB2_TAPS] = {
+    0.600191638f, -0.123078807f, 0.025041562f, -0.002154393f
+};
+
+/* Push newest-first; hist[pos + j] is the sample j steps back */
+static inline void hb_push(moog_hb_ring_t *r, int len, float x) {
+    if (--r->pos < 0) r->pos = len - 1;
+    r->hist[r->pos] = x;
+    r->hist[r->pos + len] = x;
+}
+
+/* Symmetric half-band sum around the midpoint of d[taps - 1] and d[taps] */
+static inline float hb_sum(const float *d, const float *coef, int taps) {
+    float acc = 0.0f;
+    for (int k = 0; k < taps; k++) {
+        acc += coef[k] * (d[taps - 1 - k] + d[taps + k]);
+    }
+    return acc;
+}
+
+/* 2x interpolation: each input yields the interpolated midpoint followed
+ * by the delayed input sample */
+static inline void hb_upsample(moog_hb_ring_t *r, const float *coef, int taps,
+                               const float *in, float *out, int frames) {
+    for (int i = 0; i < frames; i++) {
+        hb_push(r, 2 * taps, in[i]);
+        const float *d = r->hist + r->pos;
+        out[2 * i] = hb_sum(d, coef, taps);
+        out[2 * i + 1] = d[taps - 1];
+    }
+}
+
+/* 2x decimation: the even phase goes through the FIR taps, the odd phase
+ * only through the delayed centre tap */
+static inline void hb_downsample(moog_hb_ring_t *even, moog_hb_ring_t *odd,
+                                 const float *coef, int taps,
+                                 const float *in, float *out, int frames) {
+    for (int i = 0; i < frames; i++) {
+        hb_push(even, 2 * taps, in[2 * i]);
+        hb_push(odd, 2 * taps, in[2 * i + 1]);
+        const float *d = even->hist + even->pos;
+        out[i] = 0.5f * (odd->hist[odd->pos + taps] + hb_sum(d, coef, taps));
+    }
+}
+
+/* Zero the ladder and resampler history */
+static void clear_filter_state(moog_engine_t *engine) {
+    memset(engine->hot.filter_prev, 0, sizeof(engine->hot.filter_prev));
+    memset(engine->os_up, 0, sizeof(engine->os_up));
+    memset(engine->os_down_even, 0, sizeof(engine->os_down_even));
+    memset(engine->os_down_odd, 0, sizeof(engine->os_down_odd));
+}
+
+/* ===================================================================
+ * Shared tables
+ * =================================================================== */
+
+void moog_engine_tables_init(void) {
+    if (g_tables_ready) return;
+
+    double *sintab = (double *)malloc(sizeof(double) * MOOG_WT_SIZE * 2);
+    if (!sintab) return;
+    double *acc = sintab + MOOG_WT_SIZE;
+
+    for (int n = 0; n < MOOG_WT_SIZE; n++) {
+        sintab[n] = sin(2.0 * M_PI * n / MOOG_WT_SIZE);
+    }
+    for (int w = 0; w < WAVE_COUNT; w++) {
+        build_wavetable((moog_wave_t)w, sintab, acc);
+    }
+    free(sintab);
+
+    build_filter_table();
+    g_tables_ready = 1;
+}
+
 /* ===================================================================
  * Envelope generator
- * Based on envelope() from RaffoSynth with quadratic curves
+ * Based on envelope() from RaffoSynth with quadratic curves.
+ * Advanced a whole control tick at a time; stage transitions inside
+ * the tick carry the leftover samples into the next stage.
  * =================================================================== */
 
-static float envelope_process(moog_env_state_t *state, float *level,
-                              float *attack_level, float *release_level,
-                              double *env_counter,
-                              float attack, float decay,
-                              float sustain, float release,
-                              float sample_rate) {
-    double atk_time  = param_to_time(attack, sample_rate);
-    double dec_time  = param_to_time(decay, sample_rate);
-    double rel_time  = param_to_time(release, sample_rate);
-
-    switch (*state) {
-        case ENV_ATTACK: {
-            double progress = *env_counter / atk_time;
-            if (progress >= 1.0) {
-                *level = 1.0f;
-                *state = ENV_DECAY;
-                *env_counter = 0;
-            } else {
+static float envelope_advance(moog_env_state_t *state, float *level,
+                              const float *attack_level, const float *release_level,
+                              double *env_counter, const double *times,
+                              float sustain, int samples) {
+    double remaining = samples;
+
+    for (;;) {
+        switch (*state) {
+            case ENV_ATTACK: {
+                double atk_time = times[0];
+                double left = atk_time - *env_counter;
+                if (left <= remaining) {
+                    remaining -= (left > 0.0) ? left : 0.0;
+                    *level = 1.0f;
+                    *state = ENV_DECAY;
+                    *env_counter = 0;
+                    continue;
+                }
                 /* Quadratic attack curve from current level to 1.0 */
+                *env_counter += remaining;
+                double progress = *env_counter / atk_time;
                 float start = *attack_level;
                 float p = (float)(progress * progress);
                 *level = start + (1.0f - start) * p;
+                return *level;
             }
-            (*env_counter)++;
-            break;
-        }
-        case ENV_DECAY: {
-            double progress = *env_counter / dec_time;
-            if (progress >= 1.0) {
-                *level = sustain;
-                *state = ENV_SUSTAIN;
-                *env_counter = 0;
-            } else {
+            case ENV_DECAY: {
+                double dec_time = times[1];
+                double left = dec_time - *env_counter;
+                if (left <= remaining) {
+                    remaining -= (left > 0.0) ? left : 0.0;
+                    *state = ENV_SUSTAIN;
+                    *env_counter = 0;
+                    continue;
+                }
                 /* Quadratic decay curve */
-                float p = (float)(1.0 - progress);
+                *env_counter += remaining;
+                float p = (float)(1.0 - *env_counter / dec_time);
                 *level = sustain + (1.0f - sustain) * p * p;
+                return *level;
             }
-            (*env_counter)++;
-            break;
-        }
-        case ENV_SUSTAIN:
-            *level = sustain;
-            break;
-        case ENV_RELEASE: {
-            double progress = *env_counter / rel_time;
-            if (progress >= 1.0) {
-                *level = 0.0f;
-                *state = ENV_OFF;
-                *env_counter = 0;
-            } else {
+            case ENV_SUSTAIN:
+                *level = sustain;
+                return *level;
+            case ENV_RELEASE: {
+                double rel_time = times[2];
+                double left = rel_time - *env_counter;
+                if (left <= remaining) {
+                    *level = 0.0f;
+                    *state = ENV_OFF;
+                    *env_counter = 0;
+                    return *level;
+                }
                 /* Quadratic release curve from captured start level */
-                float p = (float)(1.0 - progress);
-                *level = *release_level * p * p;
+                *env_counter += remaining;
+                float p = (float)(1.0 - *env_counter / rel_time);
+                *level = snap_denormal(*release_level * p * p);
+                return *level;
             }
-            (*env_counter)++;
-            break;
+            case ENV_OFF:
+            default:
+                *level = 0.0f;
+                return *level;
         }
-        case ENV_OFF:
-        default:
-            *level = 0.0f;
-            break;
     }
+}
+
+/* ===================================================================
+ * Voice allocation
+ * Free voices sit on a stack; sounding voices sit on a held or a
+ * released list, oldest first. A new note takes a free voice, else the
+ * oldest released one (furthest into its release, so the quietest),
+ * else the oldest held one. Every step is O(1).
+ * =================================================================== */
 
-    return *level;
+enum { VOICE_HELD = 0, VOICE_RELEASED = 1, VOICE_FREE = 2 };
+
+/* Note period in samples, after octave transpose */
+static double note_period(const moog_engine_t *engine, int note) {
+    int effective_note = note + engine->octave_transpose * 12;
+    if (effective_note < 0) effective_note = 0;
+    if (effective_note > 127) effective_note = 127;
+    return hz_to_period(note_to_hz(effective_note), engine->sample_rate);
+}
+
+static void voice_unlink(moog_voices_t *vs, int v) {
+    int list = vs->list[v];
+    int prev = vs->prev[v];
+    int next = vs->next[v];
+    if (prev >= 0) vs->next[prev] = (int8_t)next; else vs->head[list] = (int8_t)next;
+    if (next >= 0) vs->prev[next] = (int8_t)prev; else vs->tail[list] = (int8_t)prev;
+    vs->list[v] = VOICE_FREE;
+}
+
+static void voice_append(moog_voices_t *vs, int v, int list) {
+    int tail = vs->tail[list];
+    vs->list[v] = (int8_t)list;
+    vs->prev[v] = (int8_t)tail;
+    vs->next[v] = -1;
+    if (tail >= 0) vs->next[tail] = (int8_t)v; else vs->head[list] = (int8_t)v;
+    vs->tail[list] = (int8_t)v;
+}
+
+/* Return a voice that has finished its release to the free stack */
+static void voice_free(moog_voices_t *vs, int v) {
+    voice_unlink(vs, v);
+    if (vs->note_voice[vs->note[v]] == v) vs->note_voice[vs->note[v]] = -1;
+    vs->free_stack[vs->free_count++] = (int8_t)v;
+    for (int i = 0; i < 5; i++) vs->filter_prev[i][v] = 0.0f;
+}
+
+static void voices_reset(moog_engine_t *engine) {
+    moog_voices_t *vs = &engine->voices;
+    memset(vs, 0, sizeof(*vs));
+    memset(vs->note_voice, 0xFF, sizeof(vs->note_voice));
+    vs->head[VOICE_HELD] = vs->head[VOICE_RELEASED] = -1;
+    vs->tail[VOICE_HELD] = vs->tail[VOICE_RELEASED] = -1;
+
+    /* Lowest voices first, so small chords share one vector group */
+    for (int v = 0; v < MOOG_MAX_VOICES; v++) vs->list[v] = VOICE_FREE;
+    for (int i = 0; i < engine->voice_count; i++) {
+        vs->free_stack[i] = (int8_t)(engine->voice_count - 1 - i);
+    }
+    vs->free_count = engine->voice_count;
+    vs->last_period = engine->hot.period;
+}
+
+static void voice_note_on(moog_engine_t *engine, int note, float velocity) {
+    moog_voices_t *vs = &engine->voices;
+    int v = vs->note_voice[note];
+    int from_free = 0;
+
+    if (v >= 0) {
+        /* Retrigger the voice still sounding this note */
+        voice_unlink(vs, v);
+    } else if (vs->free_count > 0) {
+        v = vs->free_stack[--vs->free_count];
+        from_free = 1;
+    } else {
+        v = (vs->head[VOICE_RELEASED] >= 0) ? vs->head[VOICE_RELEASED] : vs->head[VOICE_HELD];
+        voice_unlink(vs, v);
+        vs->note_voice[vs->note[v]] = -1;
+    }
+    voice_append(vs, v, VOICE_HELD);
+    vs->note_voice[note] = (int8_t)v;
+    vs->note[v] = note;
+    vs->velocity[v] = velocity;
+
+    /* With glide on, each new note slides from the previous one. A voice
+     * from the free stack starts at its pitch instead of ramping from the
+     * last note it played. */
+    double target_period = note_period(engine, note);
+    vs->period[v] = (engine->glide > 0.001f) ? vs->last_period : target_period;
+    vs->glide_period[v] = target_period;
+    vs->last_period = target_period;
+    if (from_free) vs->ctl_base_inc[v] = (float)(1.0 / vs->period[v]);
+
+    /* Envelopes restart from their current level (smooth steal and retrigger) */
+    vs->amp_env_attack_level[v] = vs->amp_env_level[v];
+    vs->amp_env_state[v] = ENV_ATTACK;
+    vs->amp_env_counter[v] = 0;
+    vs->filt_env_attack_level[v] = vs->filt_env_level[v];
+    vs->filt_env_state[v] = ENV_ATTACK;
+    vs->filt_env_counter[v] = 0;
+}
+
+static void voice_release(moog_voices_t *vs, int v) {
+    voice_unlink(vs, v);
+    voice_append(vs, v, VOICE_RELEASED);
+    if (vs->amp_env_state[v] != ENV_OFF) {
+        vs->amp_env_release_level[v] = vs->amp_env_level[v];
+        vs->amp_env_state[v] = ENV_RELEASE;
+        vs->amp_env_counter[v] = 0;
+    }
+    if (vs->filt_env_state[v] != ENV_OFF) {
+        vs->filt_env_release_level[v] = vs->filt_env_level[v];
+        vs->filt_env_state[v] = ENV_RELEASE;
+        vs->filt_env_counter[v] = 0;
+    }
+}
+
+static void voice_note_off(moog_engine_t *engine, int note) {
+    moog_voices_t *vs = &engine->voices;
+    int v = vs->note_voice[note];
+    if (v >= 0 && vs->list[v] == VOICE_HELD) voice_release(vs, v);
+}
+
+/* Cut every voice; each is freed once its filter has rung out */
+static void voices_all_off(moog_engine_t *engine) {
+    moog_voices_t *vs = &engine->voices;
+    while (vs->head[VOICE_HELD] >= 0) voice_release(vs, vs->head[VOICE_HELD]);
+    for (int v = 0; v < engine->voice_count; v++) {
+        vs->amp_env_state[v] = ENV_OFF;
+        vs->amp_env_level[v] = 0.0f;
+        vs->filt_env_state[v] = ENV_OFF;
+        vs->filt_env_level[v] = 0.0f;
+    }
 }
 
 /* ===================================================================
@@ -217,6 +1033,9 @@ static float envelope_process(moog_env_state_t *state, float *level,
 void moog_engine_init(moog_engine_t *engine) {
     memset(engine, 0, sizeof(moog_engine_t));
 
+    /* Normally already built at plugin load */
+    moog_engine_tables_init();
+
     engine->sample_rate = MOOG_SAMPLE_RATE;
 
     /* Default oscillator settings */
@@ -235,12 +1054,15 @@ void moog_engine_init(moog_engine_t *engine) {
     engine->osc2_detune = 0.0f;
     engine->osc3_detune = 0.0f;
     engine->osc4_detune = 0.5f;
+    engine->osc_mode = MOOG_DEFAULT_OSC_MODE;
 
     /* Filter - open with moderate resonance */
     engine->filter_cutoff = 0.7f;
     engine->filter_resonance = 0.2f;
     engine->filter_contour = 0.3f;
     engine->filter_key_follow = 0.0f;
+    engine->filter_mode = MOOG_FILTER_BLOCK;
+    engine->filter_oversample = MOOG_FILTER_OS_1X;
 
     /* Amp envelope */
     engine->amp_attack = 0.01f;
@@ -270,26 +1092,75 @@ void moog_engine_init(moog_engine_t *engine) {
     engine->lfo_depth_filter = 0.0f;
 
     /* Noise seed */
-    engine->noise_seed = 12345;
+    engine->hot.noise_seed = 12345;
+
+    moog_engine_update_pitch(engine);
+    moog_engine_update_envelopes(engine);
 
     /* Initialize period to middle C */
-    engine->period = hz_to_period(note_to_hz(60), engine->sample_rate);
-    engine->glide_period = engine->period;
+    engine->hot.period = hz_to_period(note_to_hz(60), engine->sample_rate);
+    engine->hot.glide_period = engine->hot.period;
+
+    /* Control rate and the first control point */
+    engine->control_rate = MOOG_DEFAULT_CONTROL_RATE;
+    engine->hot.ctl_base_inc = (float)(1.0 / engine->hot.period);
+    engine->hot.ctl_amp = 0.0f;
+    engine->hot.ctl_cutoff = engine->filter_cutoff;
+
+    engine->voice_count = 1;
+    voices_reset(engine);
+}
+
+void moog_engine_set_voices(moog_engine_t *engine, int count) {
+    if (count < 1) count = 1;
+    if (count > MOOG_MAX_VOICES) count = MOOG_MAX_VOICES;
+    if (count == engine->voice_count) return;
+
+    moog_engine_all_notes_off(engine);
+    engine->voice_count = count;
+    voices_reset(engine);
+}
+
+void moog_engine_update_pitch(moog_engine_t *engine) {
+    /* Detune is stored 0.0-1.0, centered at 0.5 -> -50 to +50 cents.
+     * Osc 2 and 3 treat 0.0 as "no detune" for legacy presets. */
+    float detune[4] = { 0.5f, engine->osc2_detune, engine->osc3_detune, engine->osc4_detune };
+
+    for (int osc = 0; osc < 4; osc++) {
+        double ratio = pow(2.0, (double)engine->osc_range[osc]);
+        int bypass = (osc == 3) ? fabsf(detune[osc] - 0.5f) <= 0.001f
+                                : fabsf(detune[osc]) <= 0.001f;
+        if (osc > 0 && !bypass) {
+            double detune_cents = (detune[osc] - 0.5f) * 100.0;
+            ratio *= pow(2.0, detune_cents / 1200.0);
+        }
+        engine->osc_ratio[osc] = (float)ratio;
+    }
+}
+
+void moog_engine_update_envelopes(moog_engine_t *engine) {
+    float sr = engine->sample_rate;
+    engine->amp_env_times[0] = param_to_time(engine->amp_attack, sr);
+    engine->amp_env_times[1] = param_to_time(engine->amp_decay, sr);
+    engine->amp_env_times[2] = param_to_time(engine->amp_release, sr);
+    engine->filt_env_times[0] = param_to_time(engine->filt_attack, sr);
+    engine->filt_env_times[1] = param_to_time(engine->filt_decay, sr);
+    engine->filt_env_times[2] = param_to_time(engine->filt_release, sr);
 }
 
 void moog_engine_reset(moog_engine_t *engine) {
-    engine->amp_env_state = ENV_OFF;
-    engine->amp_env_level = 0.0f;
-    engine->amp_env_counter = 0;
-    engine->filt_env_state = ENV_OFF;
-    engine->filt_env_level = 0.0f;
-    engine->filt_env_counter = 0;
+    engine->hot.amp_env_state = ENV_OFF;
+    engine->hot.amp_env_level = 0.0f;
+    engine->hot.amp_env_counter = 0;
+    engine->hot.filt_env_state = ENV_OFF;
+    engine->hot.filt_env_level = 0.0f;
+    engine->hot.filt_env_counter = 0;
     engine->gate_on = 0;
     engine->current_note = -1;
     engine->key_stack_count = 0;
-    engine->counter = 0;
-    memset(engine->filter_prev, 0, sizeof(engine->filter_prev));
-    memset(engine->last_val, 0, sizeof(engine->last_val));
+    memset(engine->hot.osc_phase, 0, sizeof(engine->hot.osc_phase));
+    clear_filter_state(engine);
+    voices_reset(engine);
 }
 
 /* ===================================================================
@@ -297,25 +1168,26 @@ void moog_engine_reset(moog_engine_t *engine) {
  * =================================================================== */
 
 void moog_engine_note_on(moog_engine_t *engine, int note, float velocity) {
+    if (engine->voice_count > 1) {
+        voice_note_on(engine, note, velocity);
+        return;
+    }
+
     /* Add note to key stack */
     if (engine->key_stack_count < MOOG_MAX_KEYS) {
         engine->key_stack[engine->key_stack_count++] = note;
     }
 
     /* Calculate target period for this note */
-    int effective_note = note + engine->octave_transpose * 12;
-    if (effective_note < 0) effective_note = 0;
-    if (effective_note > 127) effective_note = 127;
-
-    double target_period = hz_to_period(note_to_hz(effective_note), engine->sample_rate);
+    double target_period = note_period(engine, note);
 
     if (engine->gate_on && engine->glide > 0.001f) {
         /* Glide to new note */
-        engine->glide_period = target_period;
+        engine->hot.glide_period = target_period;
     } else {
         /* Immediate pitch change */
-        engine->period = target_period;
-        engine->glide_period = target_period;
+        engine->hot.period = target_period;
+        engine->hot.glide_period = target_period;
     }
 
     engine->current_note = note;
@@ -326,16 +1198,21 @@ void moog_engine_note_on(moog_engine_t *engine, int note, float velocity) {
     } else {
         /* New note: trigger envelopes from current level (smooth retrigger) */
         engine->gate_on = 1;
-        engine->amp_env_attack_level = engine->amp_env_level;
-        engine->amp_env_state = ENV_ATTACK;
-        engine->amp_env_counter = 0;
-        engine->filt_env_attack_level = engine->filt_env_level;
-        engine->filt_env_state = ENV_ATTACK;
-        engine->filt_env_counter = 0;
+        engine->hot.amp_env_attack_level = engine->hot.amp_env_level;
+        engine->hot.amp_env_state = ENV_ATTACK;
+        engine->hot.amp_env_counter = 0;
+        engine->hot.filt_env_attack_level = engine->hot.filt_env_level;
+        engine->hot.filt_env_state = ENV_ATTACK;
+        engine->hot.filt_env_counter = 0;
     }
 }
 
 void moog_engine_note_off(moog_engine_t *engine, int note) {
+    if (engine->voice_count > 1) {
+        voice_note_off(engine, note);
+        return;
+    }
+
     /* Remove note from key stack */
     for (int i = 0; i < engine->key_stack_count; i++) {
         if (engine->key_stack[i] == note) {
@@ -351,31 +1228,27 @@ void moog_engine_note_off(moog_engine_t *engine, int note) {
     if (engine->key_stack_count > 0) {
         /* Play the most recent remaining note (last note priority) */
         int new_note = engine->key_stack[engine->key_stack_count - 1];
-        int effective_note = new_note + engine->octave_transpose * 12;
-        if (effective_note < 0) effective_note = 0;
-        if (effective_note > 127) effective_note = 127;
-
-        double target_period = hz_to_period(note_to_hz(effective_note), engine->sample_rate);
+        double target_period = note_period(engine, new_note);
         engine->current_note = new_note;
 
         if (engine->glide > 0.001f) {
-            engine->glide_period = target_period;
+            engine->hot.glide_period = target_period;
         } else {
-            engine->period = target_period;
-            engine->glide_period = target_period;
+            engine->hot.period = target_period;
+            engine->hot.glide_period = target_period;
         }
     } else {
         /* No notes held - release */
         engine->gate_on = 0;
-        if (engine->amp_env_state != ENV_OFF) {
-            engine->amp_env_release_level = engine->amp_env_level;
-            engine->amp_env_state = ENV_RELEASE;
-            engine->amp_env_counter = 0;
+        if (engine->hot.amp_env_state != ENV_OFF) {
+            engine->hot.amp_env_release_level = engine->hot.amp_env_level;
+            engine->hot.amp_env_state = ENV_RELEASE;
+            engine->hot.amp_env_counter = 0;
         }
-        if (engine->filt_env_state != ENV_OFF) {
-            engine->filt_env_release_level = engine->filt_env_level;
-            engine->filt_env_state = ENV_RELEASE;
-            engine->filt_env_counter = 0;
+        if (engine->hot.filt_env_state != ENV_OFF) {
+            engine->hot.filt_env_release_level = engine->hot.filt_env_level;
+            engine->hot.filt_env_state = ENV_RELEASE;
+            engine->hot.filt_env_counter = 0;
         }
     }
 }
@@ -391,165 +1264,969 @@ void moog_engine_mod_wheel(moog_engine_t *engine, float amount) {
 void moog_engine_all_notes_off(moog_engine_t *engine) {
     engine->key_stack_count = 0;
     engine->gate_on = 0;
-    engine->amp_env_state = ENV_OFF;
-    engine->amp_env_level = 0.0f;
-    engine->filt_env_state = ENV_OFF;
-    engine->filt_env_level = 0.0f;
+    engine->hot.amp_env_state = ENV_OFF;
+    engine->hot.amp_env_level = 0.0f;
+    engine->hot.filt_env_state = ENV_OFF;
+    engine->hot.filt_env_level = 0.0f;
     engine->current_note = -1;
+    voices_all_off(engine);
+}
+
+/* ===================================================================
+ * Parameter smoothing
+ * Only fields with a ramp in progress hold a slot, so the per-tick cost
+ * is proportional to the number of ramping parameters.
+ * =================================================================== */
+
+void moog_engine_set_smoothed(moog_engine_t *engine, float *field, float value, float time_ms) {
+    uint16_t offset = (uint16_t)((char *)field - (char *)engine);
+
+    int slot = -1;
+    for (int i = 0; i < engine->smooth_count; i++) {
+        if (engine->smooth[i].offset == offset) {
+            slot = i;
+            break;
+        }
+    }
+
+    int rate = engine->control_rate;
+    if (rate < 1) rate = 1;
+    int ticks = (int)(time_ms * 0.001f * engine->sample_rate / rate + 0.5f);
+
+    if (ticks < 1 || *field == value) {
+        *field = value;
+        if (slot >= 0) engine->smooth[slot] = engine->smooth[--engine->smooth_count];
+        return;
+    }
+    if (slot < 0) {
+        /* Out of slots: jump rather than drop the change */
+        if (engine->smooth_count >= MOOG_SMOOTH_MAX) {
+            *field = value;
+            return;
+        }
+        slot = engine->smooth_count++;
+    }
+
+    moog_smoother_t *s = &engine->smooth[slot];
+    s->offset = offset;
+    s->ticks = ticks;
+    s->step = (value - *field) / ticks;
+    s->target = value;
+}
+
+/* Advance every active ramp by one control tick */
+static void smooth_tick(moog_engine_t *engine) {
+    for (int i = 0; i < engine->smooth_count; ) {
+        moog_smoother_t *s = &engine->smooth[i];
+        float *field = (float *)((char *)engine + s->offset);
+        if (--s->ticks > 0) {
+            *field += s->step;
+            i++;
+        } else {
+            *field = s->target;
+            *s = engine->smooth[--engine->smooth_count];
+        }
+    }
 }
 
 /* ===================================================================
  * Audio rendering
+ * Two stages per segment of up to MOOG_MAX_RENDER samples:
+ *   1. Control pass - parameter smoothing, glide, LFO, envelopes,
+ *      velocity, key tracking and cutoff modulation, evaluated once
+ *      every control_rate samples.
+ *   2. Audio pass - oscillator, amp and filter kernels over the whole
+ *      segment, linearly ramping between consecutive control points.
+ * Control point 0 of each segment is the last point of the previous
+ * one, so ramps are continuous across blocks.
  * =================================================================== */
 
-void moog_engine_render(moog_engine_t *engine, float *output, int frames) {
+typedef struct {
+    int rate;                               /* Samples per control tick */
+    int ticks;                              /* Control ticks in this segment */
+    float base_inc[MOOG_MAX_RENDER + 1];    /* Oscillator phase increment at ratio 1 */
+    float amp[MOOG_MAX_RENDER + 1];         /* Amp envelope x velocity */
+    float cutoff[MOOG_MAX_RENDER + 1];      /* Normalized cutoff (0.0 - 1.0) */
+    float resonance[MOOG_MAX_RENDER + 1];   /* Filter resonance, held per tick */
+    float volume[MOOG_MAX_RENDER + 1];      /* Master volume */
+    float osc_volume[MOOG_MAX_RENDER + 1][4]; /* Oscillator volumes, held per tick */
+    float pitch_mul[MOOG_MAX_RENDER + 1];   /* Bend x LFO pitch ratio (voice pool) */
+    float cutoff_base[MOOG_MAX_RENDER + 1]; /* Cutoff + LFO, before envelope and keys */
+    double glide_keep;                      /* Glide approach factor per sample */
+    double glide_keep_tick;                 /* ... and per full tick */
+} moog_control_t;
+
+/* Block length the legacy glide rate was defined against */
+#define MOOG_GLIDE_REF_FRAMES 128
+
+static inline int tick_length(const moog_control_t *ctl, int tick, int frames) {
+    int start = tick * ctl->rate;
+    return (frames - start < ctl->rate) ? frames - start : ctl->rate;
+}
+
+static void control_pass(moog_engine_t *engine, moog_control_t *ctl, int frames) {
     float sr = engine->sample_rate;
 
     /* Compute pitch bend multiplier */
     float bend_semitones = engine->pitch_bend * engine->bend_range * 12.0f;
     double bend_ratio = pow(2.0, bend_semitones / 12.0);
 
-    /* Compute glide rate */
-    double glide_rate = 1.0;
+    /* Glide: per-sample approach factor. The legacy curve was scaled by
+     * the host block length; it is pinned to that length so renders split
+     * at MIDI events glide at the same speed. */
+    double glide_keep = 0.0;
     if (engine->glide > 0.001f) {
         double glide_time = engine->glide * engine->glide * 2.0 * sr;
-        glide_rate = 1.0 / (1.0 + glide_time / (double)frames);
+        glide_keep = 1.0 - 1.0 / (1.0 + glide_time / (double)MOOG_GLIDE_REF_FRAMES);
     }
+    double glide_keep_tick = pow(glide_keep, ctl->rate);
+    ctl->glide_keep = glide_keep;
+    ctl->glide_keep_tick = glide_keep_tick;
 
     /* LFO */
     float lfo_freq = 0.1f + engine->lfo_rate * engine->lfo_rate * 20.0f; /* 0.1 - 20 Hz */
     float lfo_inc = lfo_freq / sr;
 
-    for (int i = 0; i < frames; i++) {
+    /* Apply velocity sensitivity */
+    float vel_scale = 1.0f - engine->velocity_sensitivity + engine->velocity_sensitivity * engine->velocity;
+
+    /* Key tracking */
+    float key_track = 0.0f;
+    if (engine->current_note >= 0) {
+        key_track = (engine->current_note - 60) / 127.0f * engine->filter_key_follow;
+    }
+
+    ctl->ticks = (frames + ctl->rate - 1) / ctl->rate;
+    ctl->base_inc[0] = engine->hot.ctl_base_inc;
+    ctl->amp[0] = engine->hot.ctl_amp;
+    ctl->cutoff[0] = engine->hot.ctl_cutoff;
+    ctl->resonance[0] = engine->filter_resonance;
+    ctl->volume[0] = engine->master_volume;
+    memcpy(ctl->osc_volume[0], engine->osc_volume, sizeof(ctl->osc_volume[0]));
+
+    for (int t = 0; t < ctl->ticks; t++) {
+        int n = tick_length(ctl, t, frames);
+
+        if (engine->smooth_count > 0) smooth_tick(engine);
+        ctl->resonance[t + 1] = engine->filter_resonance;
+        ctl->volume[t + 1] = engine->master_volume;
+        memcpy(ctl->osc_volume[t + 1], engine->osc_volume, sizeof(ctl->osc_volume[0]));
+
         /* Update glide */
-        if (fabs(engine->period - engine->glide_period) > 0.01) {
-            engine->period += (engine->glide_period - engine->period) * glide_rate;
+        if (fabs(engine->hot.period - engine->hot.glide_period) > 0.01) {
+            double keep = (n == ctl->rate) ? glide_keep_tick : pow(glide_keep, n);
+            engine->hot.period = engine->hot.glide_period + (engine->hot.period - engine->hot.glide_period) * keep;
         }
 
-        /* Current period with pitch bend and mod */
-        double current_period = engine->period / bend_ratio;
-
         /* LFO */
-        engine->lfo_phase += lfo_inc;
-        if (engine->lfo_phase >= 1.0f) engine->lfo_phase -= 1.0f;
-        float lfo_val = sinf(engine->lfo_phase * 2.0f * (float)M_PI);
+        engine->hot.lfo_phase += lfo_inc * n;
+        engine->hot.lfo_phase -= floorf(engine->hot.lfo_phase);
+        float lfo_val = sinf(engine->hot.lfo_phase * 2.0f * (float)M_PI);
 
         /* Apply mod wheel modulation to LFO depths */
         float pitch_mod = lfo_val * engine->lfo_depth_pitch * engine->mod_to_pitch * engine->mod_wheel;
 
-        /* Pitch modulation */
-        if (fabsf(pitch_mod) > 0.0001f) {
-            double mod_ratio = pow(2.0, pitch_mod * 2.0 / 12.0);
-            current_period /= mod_ratio;
-        }
+        /* Base phase increment with pitch bend and mod (+/-2 semitones at full depth) */
+        float mod_ratio = fast_exp2f(pitch_mod * (2.0f / 12.0f));
+        ctl->base_inc[t + 1] = (float)(bend_ratio * mod_ratio / engine->hot.period);
+        ctl->pitch_mul[t + 1] = (float)(bend_ratio * mod_ratio);
 
         /* Process envelopes */
-        float amp_env = envelope_process(&engine->amp_env_state, &engine->amp_env_level,
-                                         &engine->amp_env_attack_level,
-                                         &engine->amp_env_release_level,
-                                         &engine->amp_env_counter,
-                                         engine->amp_attack, engine->amp_decay,
-                                         engine->amp_sustain, engine->amp_release,
-                                         sr);
-
-        float filt_env = envelope_process(&engine->filt_env_state, &engine->filt_env_level,
-                                          &engine->filt_env_attack_level,
-                                          &engine->filt_env_release_level,
-                                          &engine->filt_env_counter,
-                                          engine->filt_attack, engine->filt_decay,
-                                          engine->filt_sustain, engine->filt_release,
-                                          sr);
-
-        /* Apply velocity sensitivity */
-        float vel_scale = 1.0f - engine->velocity_sensitivity + engine->velocity_sensitivity * engine->velocity;
-
-        /* Generate oscillator samples */
-        float sample = 0.0f;
+        float amp_env = envelope_advance(&engine->hot.amp_env_state, &engine->hot.amp_env_level,
+                                         &engine->hot.amp_env_attack_level,
+                                         &engine->hot.amp_env_release_level,
+                                         &engine->hot.amp_env_counter, engine->amp_env_times,
+                                         engine->amp_sustain, n);
+
+        float filt_env = envelope_advance(&engine->hot.filt_env_state, &engine->hot.filt_env_level,
+                                          &engine->hot.filt_env_attack_level,
+                                          &engine->hot.filt_env_release_level,
+                                          &engine->hot.filt_env_counter, engine->filt_env_times,
+                                          engine->filt_sustain, n);
+
+        ctl->amp[t + 1] = amp_env * vel_scale;
+
+        /* Filter cutoff with envelope, key tracking and LFO modulation */
+        float filt_env_mod = filt_env * engine->filter_contour;
+        float lfo_filt = lfo_val * engine->lfo_depth_filter * engine->mod_to_filter * 0.3f;
+        ctl->cutoff_base[t + 1] = engine->filter_cutoff + lfo_filt;
+        ctl->cutoff[t + 1] = clampf(engine->filter_cutoff + filt_env_mod + key_track + lfo_filt,
+                                    0.0f, 1.0f);
+    }
+
+    engine->hot.ctl_base_inc = ctl->base_inc[ctl->ticks];
+    engine->hot.ctl_amp = ctl->amp[ctl->ticks];
+    engine->hot.ctl_cutoff = ctl->cutoff[ctl->ticks];
+}
+
+/* Oscillators (and noise) into buf, increments ramped per control tick */
+static void osc_pass(moog_engine_t *engine, const moog_control_t *ctl, float *buf, int frames) {
+    moog_osc_mode_t osc_mode = engine->osc_mode;
+    if (osc_mode == MOOG_OSC_WAVETABLE && !g_tables_ready) osc_mode = MOOG_OSC_POLYBLEP;
+
+    /* Naive and PolyBLEP shapes run on the vector bank when SIMD is
+     * available; wavetables and non-SIMD builds use the scalar loop.
+     * MOOG_SCALAR_OSC forces the scalar reference loop. */
+#if defined(MOOG_SCALAR_OSC) || !MOOG_SIMD
+    int vector_osc = 0;
+#else
+    int vector_osc = (osc_mode != MOOG_OSC_WAVETABLE);
+#endif
+
+    if (vector_osc) {
+        int band_limited = (osc_mode == MOOG_OSC_POLYBLEP);
+        osc_lanes_t lanes;
+        osc_lanes_setup(engine, &lanes);
+        v4f phase = v4f_load(engine->hot.osc_phase);
+        v4f inc = v4f_load(engine->hot.osc_inc);
+
+        for (int t = 0, i = 0; t < ctl->ticks; t++) {
+            int n = tick_length(ctl, t, frames);
+            float base_inc = ctl->base_inc[t];
+            float step = (ctl->base_inc[t + 1] - base_inc) / n;
+            osc_lanes_volume(&lanes, ctl->osc_volume[t + 1]);
+            for (int j = 0; j < n; j++, i++) {
+                base_inc += step;
+                buf[i] = osc_lanes_tick(&lanes, &phase, &inc, base_inc, band_limited);
+            }
+        }
+
+        v4f_store(engine->hot.osc_phase, phase);
+        v4f_store(engine->hot.osc_inc, inc);
+    } else {
+        memset(buf, 0, sizeof(float) * frames);
 
         for (int osc = 0; osc < 4; osc++) {
-            if (engine->osc_volume[osc] < 0.001f) continue;
+            moog_wave_t wave = engine->osc_wave[osc];
+            float ratio = engine->osc_ratio[osc];
+            float phase = engine->hot.osc_phase[osc];
+            float osc_inc = engine->hot.osc_inc[osc];
+
+            for (int t = 0, i = 0; t < ctl->ticks; t++) {
+                int n = tick_length(ctl, t, frames);
+                float volume = ctl->osc_volume[t + 1][osc];
+                int active = (volume >= 0.001f);
+                float base_inc = ctl->base_inc[t];
+                float step = (ctl->base_inc[t + 1] - base_inc) / n;
+                for (int j = 0; j < n; j++, i++) {
+                    /* Oscillator period never drops below 2 samples */
+                    base_inc += step;
+                    osc_inc = base_inc * ratio;
+                    if (osc_inc > 0.5f) osc_inc = 0.5f;
+
+                    if (active) {
+                        float osc_sample;
+                        switch (osc_mode) {
+                            case MOOG_OSC_WAVETABLE:
+                                osc_sample = generate_osc_wavetable(wave, phase, osc_inc);
+                                break;
+                            case MOOG_OSC_POLYBLEP:
+                                osc_sample = generate_osc_blep(wave, phase, osc_inc);
+                                break;
+                            default:
+                                osc_sample = generate_osc(wave, phase);
+                                break;
+                        }
+                        buf[i] += osc_sample * volume;
+                    }
+
+                    /* Advance and wrap phase (all oscillators stay in step when unmuted) */
+                    phase += osc_inc;
+                    if (phase >= 1.0f) phase -= 1.0f;
+                }
+            }
+
+            engine->hot.osc_phase[osc] = phase;
+            engine->hot.osc_inc[osc] = osc_inc;
+        }
+    }
+
+    /* Add noise */
+    if (engine->noise_volume > 0.001f) {
+        for (int i = 0; i < frames; i++) {
+            buf[i] += noise_sample(&engine->hot.noise_seed) * engine->noise_volume;
+        }
+    }
+}
+
+/* Apply amplitude envelope and velocity */
+static void amp_pass(const moog_control_t *ctl, float *buf, int frames) {
+    for (int t = 0, i = 0; t < ctl->ticks; t++) {
+        int n = tick_length(ctl, t, frames);
+        float gain = ctl->amp[t];
+        float step = (ctl->amp[t + 1] - gain) / n;
+        for (int j = 0; j < n; j++, i++) {
+            gain += step;
+            buf[i] *= gain;
+        }
+    }
+}
 
-            /* Calculate oscillator period with range offset */
-            double osc_period = current_period;
-            int range = engine->osc_range[osc];
-            if (range != 0) {
-                osc_period *= pow(2.0, -(double)range);
+/* Apply master volume, ramped per control tick */
+static void volume_pass(const moog_control_t *ctl, float *buf, int frames) {
+    for (int t = 0, i = 0; t < ctl->ticks; t++) {
+        int n = tick_length(ctl, t, frames);
+        float gain = ctl->volume[t];
+        float step = (ctl->volume[t + 1] - gain) / n;
+        for (int j = 0; j < n; j++, i++) {
+            gain += step;
+            buf[i] *= gain;
+        }
+    }
+}
+
+static inline filter_coef_t filter_coef(const filter_coef_t *table, float cutoff_normalized,
+                                        float sample_rate) {
+    return table ? filter_coef_lookup(table, cutoff_normalized)
+                 : filter_coef_exact(cutoff_normalized, sample_rate);
+}
+
+/* Ladder over buf, which holds 2^level samples per output frame. Per-sample
+ * mode holds one coefficient set per output frame, block mode ramps the
+ * coefficients of each tick. */
+static void filter_ladder(moog_engine_t *engine, const moog_control_t *ctl, float *buf,
+                          int frames, moog_filter_os_t level, float *state) {
+    int os = 1 << level;
+    float sr = engine->sample_rate * os;
+    const filter_coef_t *table = NULL;
+    if (g_tables_ready && engine->sample_rate == (float)MOOG_SAMPLE_RATE) {
+        table = g_filter_table[level];
+    }
+    int soft_clip = (os > 1);
+
+    if (engine->filter_mode == MOOG_FILTER_BLOCK) {
+        filter_coef_t c0 = filter_coef(table, ctl->cutoff[0], sr);
+        for (int t = 0, i = 0; t < ctl->ticks; t++) {
+            int n = tick_length(ctl, t, frames);
+            filter_coef_t c1 = filter_coef(table, ctl->cutoff[t + 1], sr);
+            moog_filter_process(buf + i * os, state, n * os, c0, c1,
+                                ctl->resonance[t + 1], soft_clip);
+            c0 = c1;
+            i += n;
+        }
+    } else {
+        for (int t = 0, i = 0; t < ctl->ticks; t++) {
+            int n = tick_length(ctl, t, frames);
+            float resonance = ctl->resonance[t + 1];
+            float cutoff_normalized = ctl->cutoff[t];
+            float step = (ctl->cutoff[t + 1] - cutoff_normalized) / n;
+            for (int j = 0; j < n; j++, i++) {
+                cutoff_normalized += step;
+                filter_coef_t c = filter_coef(table, cutoff_normalized, sr);
+                moog_filter_process(buf + i * os, state, os, c, c, resonance, soft_clip);
             }
+        }
+    }
+}
+
+/* Moog ladder over the segment. The state stays in locals for the whole
+ * segment. With oversampling the segment is interpolated up through the
+ * half-band stages, filtered at the higher rate and decimated back. */
+static void filter_pass(moog_engine_t *engine, const moog_control_t *ctl, float *buf, int frames) {
+    float state[5];
+    memcpy(state, engine->hot.filter_prev, sizeof(state));
+
+    switch (engine->filter_oversample) {
+        case MOOG_FILTER_OS_2X: {
+            float x2[MOOG_MAX_RENDER * 2];
+            hb_upsample(&engine->os_up[0], g_hb1_coef, HB1_TAPS, buf, x2, frames);
+            filter_ladder(engine, ctl, x2, frames, MOOG_FILTER_OS_2X, state);
+            hb_downsample(&engine->os_down_even[0], &engine->os_down_odd[0],
+                          g_hb1_coef, HB1_TAPS, x2, buf, frames);
+            break;
+        }
+        case MOOG_FILTER_OS_4X: {
+            float x2[MOOG_MAX_RENDER * 2];
+            float x4[MOOG_MAX_RENDER * 4];
+            hb_upsample(&engine->os_up[0], g_hb1_coef, HB1_TAPS, buf, x2, frames);
+            hb_upsample(&engine->os_up[1], g_hb2_coef, HB2_TAPS, x2, x4, frames * 2);
+            filter_ladder(engine, ctl, x4, frames, MOOG_FILTER_OS_4X, state);
+            hb_downsample(&engine->os_down_even[1], &engine->os_down_odd[1],
+                          g_hb2_coef, HB2_TAPS, x4, x2, frames * 2);
+            hb_downsample(&engine->os_down_even[0], &engine->os_down_odd[0],
+                          g_hb1_coef, HB1_TAPS, x2, buf, frames);
+            break;
+        }
+        default:
+            filter_ladder(engine, ctl, buf, frames, MOOG_FILTER_OS_1X, state);
+            break;
+    }
+
+    for (int i = 0; i < 5; i++) {
+        engine->hot.filter_prev[i] = snap_denormal(state[i]);
+    }
+}
+
+/* Idle once the amp envelope is off, its ramp has reached zero and the
+ * ladder has rung down */
+static int engine_idle(const moog_engine_t *engine, const moog_control_t *ctl) {
+    if (engine->hot.amp_env_state != ENV_OFF || ctl->amp[0] != 0.0f) return 0;
+    for (int i = 0; i < 5; i++) {
+        if (fabsf(engine->hot.filter_prev[i]) >= MOOG_SILENCE_THRESHOLD) return 0;
+    }
+    return 1;
+}
+
+/* Idle segment: nothing is rendered, but the oscillators keep running
+ * so phases stay free-running across notes */
+static void idle_pass(moog_engine_t *engine, const moog_control_t *ctl, int frames) {
+    for (int osc = 0; osc < 4; osc++) {
+        float ratio = engine->osc_ratio[osc];
+        double phase = engine->hot.osc_phase[osc];
+        float osc_inc = 0.0f;
+
+        for (int t = 0; t < ctl->ticks; t++) {
+            int n = tick_length(ctl, t, frames);
+            osc_inc = ctl->base_inc[t + 1] * ratio;
+            if (osc_inc > 0.5f) osc_inc = 0.5f;
+            phase += 0.5 * (ctl->base_inc[t] * ratio + osc_inc) * n;
+        }
 
-            /* Apply detune for osc 2, 3, and 4 */
-            if (osc == 1 && fabsf(engine->osc2_detune) > 0.001f) {
-                double detune_cents = (engine->osc2_detune - 0.5f) * 100.0; /* -50 to +50 cents */
-                osc_period *= pow(2.0, -detune_cents / 1200.0);
+        engine->hot.osc_phase[osc] = (float)(phase - floor(phase));
+        engine->hot.osc_inc[osc] = osc_inc;
+    }
+}
+
+/* ===================================================================
+ * 4-lane kernel
+ * Oscillators, noise, amp envelope and ladder for four lanes at once,
+ * where a lane is a voice of the pool or a whole engine in a batch
+ * render. The ladder runs in block mode at the output rate.
+ * =================================================================== */
+
+typedef struct {
+    float base_inc[MOOG_MAX_RENDER + 1][4];
+    float amp[MOOG_MAX_RENDER + 1][4];
+    float cutoff[MOOG_MAX_RENDER + 1][4];
+} moog_lane_control_t;
+
+typedef struct {
+    const moog_control_t *ctl[4];       /* Per lane: resonance and osc volumes */
+    const moog_lane_control_t *lctl;    /* Per-lane control points */
+    osc_lanes_t shape[4];               /* Oscillator osc of each lane */
+    const float (*noise)[4];            /* Pre-scaled noise per lane, or NULL */
+    float *osc_phase[4];                /* Four lanes per oscillator */
+    float *osc_inc[4];
+    float *filter_prev[5];              /* Four lanes per ladder stage */
+    const filter_coef_t *table;         /* NULL for exact coefficients */
+    float sample_rate;
+    int band_limited;
+} lane_pass_t;
+
+/* Ladder coefficients for four cutoffs, one per lane */
+static inline void lane_filter_coefs(const lane_pass_t *lp, const float *cutoff,
+                                     v4f *f, v4f *gain, v4f *fb_comp) {
+    float fv[4], gv[4], cv[4];
+    for (int lane = 0; lane < 4; lane++) {
+        filter_coef_t c = filter_coef(lp->table, cutoff[lane], lp->sample_rate);
+        fv[lane] = c.f;
+        gv[lane] = c.gain;
+        cv[lane] = c.fb_comp;
+    }
+    *f = v4f_load(fv);
+    *gain = v4f_load(gv);
+    *fb_comp = v4f_load(cv);
+}
+
+/* Render the lanes. Output is summed into sum_out (voices) or written
+ * per lane to lane_out (engines); the other is NULL. */
+static void lane_audio_pass(const lane_pass_t *lp, float *sum_out, float (*lane_out)[4],
+                            int frames) {
+    const moog_control_t *ctl = lp->ctl[0];
+    const moog_lane_control_t *lctl = lp->lctl;
+
+    v4f phase[4];
+    v4f inc[4];
+    for (int osc = 0; osc < 4; osc++) {
+        phase[osc] = v4f_load(lp->osc_phase[osc]);
+        inc[osc] = v4f_load(lp->osc_inc[osc]);
+    }
+    v4f b0 = v4f_load(lp->filter_prev[0]);
+    v4f b1 = v4f_load(lp->filter_prev[1]);
+    v4f b2 = v4f_load(lp->filter_prev[2]);
+    v4f b3 = v4f_load(lp->filter_prev[3]);
+    v4f b4 = v4f_load(lp->filter_prev[4]);
+
+    v4f zero = v4f_set1(0.0f);
+    v4f one = v4f_set1(1.0f);
+    v4f k03 = v4f_set1(0.3f);
+    v4f clip_hi = v4f_set1(4.0f);
+    v4f clip_lo = v4f_set1(-4.0f);
+    v4f f, gain, fb_comp;
+    lane_filter_coefs(lp, lctl->cutoff[0], &f, &gain, &fb_comp);
+
+    for (int t = 0, i = 0; t < ctl->ticks; t++) {
+        int n = tick_length(ctl, t, frames);
+        v4f inv_n = v4f_set1(1.0f / n);
+
+        v4f base_inc = v4f_load(lctl->base_inc[t]);
+        v4f base_step = v4f_mul(v4f_sub(v4f_load(lctl->base_inc[t + 1]), base_inc), inv_n);
+        v4f amp = v4f_load(lctl->amp[t]);
+        v4f amp_step = v4f_mul(v4f_sub(v4f_load(lctl->amp[t + 1]), amp), inv_n);
+
+        v4f f1, gain1, fb_comp1;
+        lane_filter_coefs(lp, lctl->cutoff[t + 1], &f1, &gain1, &fb_comp1);
+        v4f df = v4f_mul(v4f_sub(f1, f), inv_n);
+        v4f dgain = v4f_mul(v4f_sub(gain1, gain), inv_n);
+        v4f dfb_comp = v4f_mul(v4f_sub(fb_comp1, fb_comp), inv_n);
+
+        /* Per-lane resonance and oscillator volumes; near-silent ones muted */
+        float res[4];
+        float vol[4][4];
+        int osc_on[4] = { 0, 0, 0, 0 };
+        for (int lane = 0; lane < 4; lane++) {
+            res[lane] = lp->ctl[lane]->resonance[t + 1];
+            for (int osc = 0; osc < 4; osc++) {
+                float v = lp->ctl[lane]->osc_volume[t + 1][osc];
+                vol[osc][lane] = (lp->shape[osc].wave_ok[lane] && v >= 0.001f) ? v : 0.0f;
+                osc_on[osc] |= (vol[osc][lane] != 0.0f);
             }
-            if (osc == 2 && fabsf(engine->osc3_detune) > 0.001f) {
-                double detune_cents = (engine->osc3_detune - 0.5f) * 100.0;
-                osc_period *= pow(2.0, -detune_cents / 1200.0);
+        }
+        v4f resonance = v4f_load(res);
+        v4f volume[4];
+        for (int osc = 0; osc < 4; osc++) volume[osc] = v4f_load(vol[osc]);
+
+        for (int j = 0; j < n; j++, i++) {
+            base_inc = v4f_add(base_inc, base_step);
+            amp = v4f_add(amp, amp_step);
+            f = v4f_add(f, df);
+            gain = v4f_add(gain, dgain);
+            fb_comp = v4f_add(fb_comp, dfb_comp);
+
+            /* Oscillator period never drops below 2 samples */
+            v4f x = lp->noise ? v4f_load(lp->noise[i]) : zero;
+            for (int osc = 0; osc < 4; osc++) {
+                inc[osc] = v4f_min(v4f_mul(base_inc, v4f_load(lp->shape[osc].ratio)),
+                                   v4f_set1(0.5f));
+                if (osc_on[osc]) {
+                    v4f y = osc_lanes_shape(&lp->shape[osc], phase[osc], inc[osc],
+                                            lp->band_limited);
+                    x = v4f_add(x, v4f_mul(y, volume[osc]));
+                }
+                phase[osc] = v4f_wrap(v4f_add(phase[osc], inc[osc]));
+            }
+            x = v4f_mul(x, amp);
+
+            /* 4-pole ladder, one lane each (see moog_filter_process) */
+            v4f input = v4f_mul(v4f_sub(x, v4f_mul(v4f_mul(b4, resonance), fb_comp)), gain);
+            v4f g = v4f_sub(one, f);
+            b1 = v4f_add(v4f_add(input, v4f_mul(k03, b0)), v4f_mul(g, b1));
+            b0 = input;
+            b2 = v4f_add(v4f_add(b1, v4f_mul(k03, b1)), v4f_mul(g, b2));
+            b3 = v4f_add(v4f_add(b2, v4f_mul(k03, b2)), v4f_mul(g, b3));
+            b4 = v4f_add(v4f_add(b3, v4f_mul(k03, b3)), v4f_mul(g, b4));
+            b4 = v4f_max(v4f_min(b4, clip_hi), clip_lo);
+
+            if (sum_out) {
+                sum_out[i] += v4f_hsum(b4);
+            } else {
+                v4f_store(lane_out[i], b4);
+            }
+        }
+    }
+
+    for (int osc = 0; osc < 4; osc++) {
+        v4f_store(lp->osc_phase[osc], phase[osc]);
+        v4f_store(lp->osc_inc[osc], inc[osc]);
+    }
+    v4f_store(lp->filter_prev[0], b0);
+    v4f_store(lp->filter_prev[1], b1);
+    v4f_store(lp->filter_prev[2], b2);
+    v4f_store(lp->filter_prev[3], b3);
+    v4f_store(lp->filter_prev[4], b4);
+    for (int i = 0; i < 5; i++) {
+        for (int lane = 0; lane < 4; lane++) {
+            lp->filter_prev[i][lane] = snap_denormal(lp->filter_prev[i][lane]);
+        }
+    }
+}
+
+static const filter_coef_t *lane_filter_table(const moog_engine_t *engine) {
+    if (g_tables_ready && engine->sample_rate == (float)MOOG_SAMPLE_RATE) {
+        return g_filter_table[MOOG_FILTER_OS_1X];
+    }
+    return NULL;
+}
+
+/* ===================================================================
+ * Voice pool rendering
+ * Voices run four at a time through the lane kernel. The shared control
+ * pass supplies LFO, bend and parameter values; each voice adds its own
+ * glide, envelopes and key tracking. Wavetable mode plays the PolyBLEP
+ * shapes here. Groups without a sounding voice are skipped.
+ * =================================================================== */
+
+static int voice_group_active(const moog_engine_t *engine, int first) {
+    for (int v = first; v < first + 4 && v < engine->voice_count; v++) {
+        if (engine->voices.list[v] != VOICE_FREE) return 1;
+    }
+    return 0;
+}
+
+/* Control points for voices first .. first + 3; free lanes stay silent */
+static void voice_control_pass(moog_engine_t *engine, const moog_control_t *ctl,
+                               moog_lane_control_t *lctl, int first, int frames) {
+    moog_voices_t *vs = &engine->voices;
+
+    for (int lane = 0; lane < 4; lane++) {
+        int v = first + lane;
+        if (v >= engine->voice_count || vs->list[v] == VOICE_FREE) {
+            for (int t = 0; t <= ctl->ticks; t++) {
+                lctl->base_inc[t][lane] = 0.0f;
+                lctl->amp[t][lane] = 0.0f;
+                lctl->cutoff[t][lane] = 0.0f;
             }
-            if (osc == 3 && fabsf(engine->osc4_detune - 0.5f) > 0.001f) {
-                double detune_cents = (engine->osc4_detune - 0.5f) * 100.0;
-                osc_period *= pow(2.0, -detune_cents / 1200.0);
+            continue;
+        }
+
+        float vel_scale = 1.0f - engine->velocity_sensitivity +
+                          engine->velocity_sensitivity * vs->velocity[v];
+        float key_track = (vs->note[v] - 60) / 127.0f * engine->filter_key_follow;
+
+        lctl->base_inc[0][lane] = vs->ctl_base_inc[v];
+        lctl->amp[0][lane] = vs->ctl_amp[v];
+        lctl->cutoff[0][lane] = vs->ctl_cutoff[v];
+
+        for (int t = 0; t < ctl->ticks; t++) {
+            int n = tick_length(ctl, t, frames);
+
+            if (fabs(vs->period[v] - vs->glide_period[v]) > 0.01) {
+                double keep = (n == ctl->rate) ? ctl->glide_keep_tick : pow(ctl->glide_keep, n);
+                vs->period[v] = vs->glide_period[v] + (vs->period[v] - vs->glide_period[v]) * keep;
             }
+            lctl->base_inc[t + 1][lane] = (float)(ctl->pitch_mul[t + 1] / vs->period[v]);
+
+            float amp_env = envelope_advance(&vs->amp_env_state[v], &vs->amp_env_level[v],
+                                             &vs->amp_env_attack_level[v],
+                                             &vs->amp_env_release_level[v],
+                                             &vs->amp_env_counter[v], engine->amp_env_times,
+                                             engine->amp_sustain, n);
+            float filt_env = envelope_advance(&vs->filt_env_state[v], &vs->filt_env_level[v],
+                                              &vs->filt_env_attack_level[v],
+                                              &vs->filt_env_release_level[v],
+                                              &vs->filt_env_counter[v], engine->filt_env_times,
+                                              engine->filt_sustain, n);
+
+            lctl->amp[t + 1][lane] = amp_env * vel_scale;
+            lctl->cutoff[t + 1][lane] = clampf(ctl->cutoff_base[t + 1] +
+                                               filt_env * engine->filter_contour + key_track,
+                                               0.0f, 1.0f);
+        }
 
-            if (osc_period < 2.0) osc_period = 2.0;
+        vs->ctl_base_inc[v] = lctl->base_inc[ctl->ticks][lane];
+        vs->ctl_amp[v] = lctl->amp[ctl->ticks][lane];
+        vs->ctl_cutoff[v] = lctl->cutoff[ctl->ticks][lane];
+    }
+}
 
-            float osc_sample = generate_osc(engine->osc_wave[osc], engine->counter, osc_period);
-            sample += osc_sample * engine->osc_volume[osc];
+/* Free released voices whose envelope is off and whose ladder has rung out */
+static void voice_group_retire(moog_engine_t *engine, int first) {
+    moog_voices_t *vs = &engine->voices;
+    for (int v = first; v < first + 4 && v < engine->voice_count; v++) {
+        if (vs->list[v] != VOICE_RELEASED || vs->amp_env_state[v] != ENV_OFF ||
+            vs->ctl_amp[v] != 0.0f) {
+            continue;
+        }
+        int quiet = 1;
+        for (int i = 0; i < 5; i++) {
+            if (fabsf(vs->filter_prev[i][v]) >= MOOG_SILENCE_THRESHOLD) quiet = 0;
         }
+        if (quiet) voice_free(vs, v);
+    }
+}
 
-        /* Add noise */
-        if (engine->noise_volume > 0.001f) {
-            sample += noise_sample(&engine->noise_seed) * engine->noise_volume;
+/* Render the voice pool into output. Returns 0 if no voice was sounding. */
+static int voices_render(moog_engine_t *engine, const moog_control_t *ctl, float *output,
+                         int frames) {
+    moog_voices_t *vs = &engine->voices;
+    memset(output, 0, sizeof(float) * frames);
+    if (vs->head[VOICE_HELD] < 0 && vs->head[VOICE_RELEASED] < 0) return 0;
+
+    moog_lane_control_t lctl;
+    lane_pass_t lp;
+    osc_lanes_t lanes;
+    osc_lanes_setup(engine, &lanes);
+    for (int lane = 0; lane < 4; lane++) {
+        lp.ctl[lane] = ctl;
+        for (int osc = 0; osc < 4; osc++) osc_lanes_copy(&lanes, osc, &lp.shape[osc], lane);
+    }
+    lp.lctl = &lctl;
+    lp.table = lane_filter_table(engine);
+    lp.sample_rate = engine->sample_rate;
+    lp.band_limited = (engine->osc_mode != MOOG_OSC_NAIVE);
+
+    /* Noise is one shared source, mixed into every voice before its filter */
+    float noise[MOOG_MAX_RENDER][4];
+    lp.noise = NULL;
+    if (engine->noise_volume > 0.001f) {
+        for (int i = 0; i < frames; i++) {
+            float x = noise_sample(&engine->hot.noise_seed) * engine->noise_volume;
+            noise[i][0] = noise[i][1] = noise[i][2] = noise[i][3] = x;
         }
+        lp.noise = noise;
+    }
 
-        /* Apply amplitude envelope and velocity */
-        sample *= amp_env * vel_scale;
+    for (int first = 0; first < engine->voice_count; first += 4) {
+        if (!voice_group_active(engine, first)) continue;
+        voice_control_pass(engine, ctl, &lctl, first, frames);
+        for (int osc = 0; osc < 4; osc++) {
+            lp.osc_phase[osc] = &vs->osc_phase[osc][first];
+            lp.osc_inc[osc] = &vs->osc_inc[osc][first];
+        }
+        for (int i = 0; i < 5; i++) lp.filter_prev[i] = &vs->filter_prev[i][first];
+        lane_audio_pass(&lp, output, NULL, frames);
+        voice_group_retire(engine, first);
+    }
 
-        /* Per-sample filter processing for smooth envelope tracking */
-        {
-            /* Filter cutoff with per-sample envelope modulation */
-            float base_cutoff = engine->filter_cutoff;
-            float filt_env_mod = filt_env * engine->filter_contour;
+    volume_pass(ctl, output, frames);
+    return 1;
+}
 
-            /* Key tracking */
-            float key_track = 0.0f;
-            if (engine->current_note >= 0) {
-                key_track = (engine->current_note - 60) / 127.0f * engine->filter_key_follow;
+static inline int control_rate_of(const moog_engine_t *engine) {
+    int rate = engine->control_rate;
+    if (rate < 1) rate = 1;
+    if (rate > MOOG_CONTROL_MAX) rate = MOOG_CONTROL_MAX;
+    return rate;
+}
+
+/* Audio for one segment after its control pass. Returns 1 if the segment
+ * was silent. */
+static int render_segment(moog_engine_t *engine, const moog_control_t *ctl, float *output,
+                          int frames, int *idle_prev) {
+    if (engine->voice_count > 1) {
+        return !voices_render(engine, ctl, output, frames);
+    }
+    if (engine_idle(engine, ctl)) {
+        /* Snap the decayed ladder to exact zero on entering idle */
+        if (!*idle_prev) clear_filter_state(engine);
+        idle_pass(engine, ctl, frames);
+        memset(output, 0, sizeof(float) * frames);
+        *idle_prev = 1;
+        return 1;
+    }
+    osc_pass(engine, ctl, output, frames);
+    amp_pass(ctl, output, frames);
+    filter_pass(engine, ctl, output, frames);
+    volume_pass(ctl, output, frames);
+    *idle_prev = 0;
+    return 0;
+}
+
+void moog_engine_render(moog_engine_t *engine, float *output, int frames) {
+    moog_control_t ctl;
+    ctl.rate = control_rate_of(engine);
+
+    if (frames <= 0) return;
+
+    fp_mode_t fp_mode = fp_mode_enter();
+    int idle_prev = engine->silent;
+    int silent = 1;
+
+    while (frames > 0) {
+        int n = (frames > MOOG_MAX_RENDER) ? MOOG_MAX_RENDER : frames;
+
+        control_pass(engine, &ctl, n);
+        silent &= render_segment(engine, &ctl, output, n, &idle_prev);
+
+        output += n;
+        frames -= n;
+    }
+
+    __atomic_store_n(&engine->silent, silent, __ATOMIC_RELAXED);
+    fp_mode_leave(fp_mode);
+}
+
+/* ===================================================================
+ * Batch rendering
+ * Several engines over the same frames, segment by segment. Sounding
+ * mono engines in the default rendering setup (block filter at 1x,
+ * naive or PolyBLEP oscillators) with matching control rate run four
+ * to a vector through the lane kernel, one engine per lane. The rest,
+ * and lone engines, take the single-engine path.
+ * =================================================================== */
+
+#define MOOG_BATCH_MAX 16
+
+typedef struct {
+    moog_control_t ctl[4];
+    moog_lane_control_t lctl;
+    float lane_out[MOOG_MAX_RENDER][4];
+    float noise[MOOG_MAX_RENDER][4];
+    moog_engine_t *engine[4];
+    float *output[4];
+    int count;
+} batch_group_t;
+
+/* Too large for an audio thread's stack, so callers allocate it once */
+struct moog_batch_scratch {
+    batch_group_t group;
+};
+
+moog_batch_scratch_t *moog_engine_batch_scratch_create(void) {
+    return (moog_batch_scratch_t *)calloc(1, sizeof(moog_batch_scratch_t));
+}
+
+void moog_engine_batch_scratch_destroy(moog_batch_scratch_t *scratch) {
+    free(scratch);
+}
+
+static int batch_lane_ok(const moog_engine_t *engine) {
+    return engine->voice_count == 1 &&
+           engine->filter_mode == MOOG_FILTER_BLOCK &&
+           engine->filter_oversample == MOOG_FILTER_OS_1X &&
+           engine->osc_mode != MOOG_OSC_WAVETABLE;
+}
+
+static int batch_lane_matches(const moog_engine_t *a, const moog_engine_t *b) {
+    return control_rate_of(a) == control_rate_of(b) &&
+           a->osc_mode == b->osc_mode &&
+           a->sample_rate == b->sample_rate;
+}
+
+/* Render the engines collected in g, whose control passes have run */
+static void batch_group_flush(batch_group_t *g, int frames, int *idle_prev) {
+    if (g->count == 1) {
+        render_segment(g->engine[0], &g->ctl[0], g->output[0], frames, idle_prev);
+        g->count = 0;
+        return;
+    }
+
+    lane_pass_t lp;
+    float osc_phase[4][4] = { { 0 } };
+    float osc_inc[4][4] = { { 0 } };
+    float filter_prev[5][4] = { { 0 } };
+    int has_noise = 0;
+
+    memset(lp.shape, 0, sizeof(lp.shape));
+    for (int lane = 0; lane < 4; lane++) {
+        int src = (lane < g->count) ? lane : 0;
+        lp.ctl[lane] = &g->ctl[src];
+        if (lane >= g->count) {
+            /* Unused lane: no oscillators and a silent control track */
+            for (int t = 0; t <= g->ctl[0].ticks; t++) {
+                g->lctl.base_inc[t][lane] = 0.0f;
+                g->lctl.amp[t][lane] = 0.0f;
+                g->lctl.cutoff[t][lane] = 0.0f;
             }
+            continue;
+        }
 
-            /* LFO filter modulation (lfo_val already computed above) */
-            float lfo_filt = lfo_val * engine->lfo_depth_filter * engine->mod_to_filter * 0.3f;
+        moog_engine_t *e = g->engine[lane];
+        const moog_control_t *ctl = &g->ctl[lane];
+        osc_lanes_t lanes;
+        osc_lanes_setup(e, &lanes);
+        for (int osc = 0; osc < 4; osc++) {
+            osc_lanes_copy(&lanes, osc, &lp.shape[osc], lane);
+            osc_phase[osc][lane] = e->hot.osc_phase[osc];
+            osc_inc[osc][lane] = e->hot.osc_inc[osc];
+        }
+        for (int i = 0; i < 5; i++) filter_prev[i][lane] = e->hot.filter_prev[i];
+        for (int t = 0; t <= ctl->ticks; t++) {
+            g->lctl.base_inc[t][lane] = ctl->base_inc[t];
+            g->lctl.amp[t][lane] = ctl->amp[t];
+            g->lctl.cutoff[t][lane] = ctl->cutoff[t];
+        }
+        has_noise |= (e->noise_volume > 0.001f);
+    }
 
-            float cutoff_normalized = clampf(base_cutoff + filt_env_mod + key_track + lfo_filt, 0.0f, 1.0f);
+    /* Each engine keeps its own noise sequence */
+    lp.noise = NULL;
+    if (has_noise) {
+        for (int lane = 0; lane < 4; lane++) {
+            moog_engine_t *e = (lane < g->count) ? g->engine[lane] : NULL;
+            int on = e && e->noise_volume > 0.001f;
+            for (int i = 0; i < frames; i++) {
+                g->noise[i][lane] = on ? noise_sample(&e->hot.noise_seed) * e->noise_volume : 0.0f;
+            }
+        }
+        lp.noise = g->noise;
+    }
 
-            /* Map normalized cutoff to Hz (exponential: 20Hz to 20kHz) */
-            float cutoff_hz = 20.0f * powf(1000.0f, cutoff_normalized);
+    for (int osc = 0; osc < 4; osc++) {
+        lp.osc_phase[osc] = osc_phase[osc];
+        lp.osc_inc[osc] = osc_inc[osc];
+    }
+    for (int i = 0; i < 5; i++) lp.filter_prev[i] = filter_prev[i];
+    lp.lctl = &g->lctl;
+    lp.table = lane_filter_table(g->engine[0]);
+    lp.sample_rate = g->engine[0]->sample_rate;
+    lp.band_limited = (g->engine[0]->osc_mode == MOOG_OSC_POLYBLEP);
 
-            /* Inline single-sample Moog ladder filter */
-            float fc = cutoff_hz / sr;
-            if (fc > 0.49f) fc = 0.49f;
-            if (fc < 0.001f) fc = 0.001f;
+    lane_audio_pass(&lp, NULL, g->lane_out, frames);
 
-            float f = fc * 1.16f;
-            float fb = engine->filter_resonance * (1.0f - 0.15f * f * f);
+    for (int lane = 0; lane < g->count; lane++) {
+        moog_engine_t *e = g->engine[lane];
+        for (int osc = 0; osc < 4; osc++) {
+            e->hot.osc_phase[osc] = osc_phase[osc][lane];
+            e->hot.osc_inc[osc] = osc_inc[osc][lane];
+        }
+        for (int i = 0; i < 5; i++) e->hot.filter_prev[i] = filter_prev[i][lane];
 
-            float input = sample - engine->filter_prev[4] * fb;
-            input *= 0.35013f * f * f * f * f;
+        float *out = g->output[lane];
+        for (int i = 0; i < frames; i++) out[i] = g->lane_out[i][lane];
+        volume_pass(&g->ctl[lane], out, frames);
+    }
+    g->count = 0;
+}
+
+/* Up to MOOG_BATCH_MAX engines */
+static void render_batch_chunk(batch_group_t *g, moog_engine_t *const *engines,
+                               float *const *outputs, int count, int frames) {
+    int idle_prev[MOOG_BATCH_MAX];
+    int silent[MOOG_BATCH_MAX];
+    int group_index[4];
+
+    for (int k = 0; k < count; k++) {
+        idle_prev[k] = engines[k]->silent;
+        silent[k] = 1;
+    }
+    g->count = 0;
+
+    for (int pos = 0; pos < frames; pos += MOOG_MAX_RENDER) {
+        int n = (frames - pos > MOOG_MAX_RENDER) ? MOOG_MAX_RENDER : frames - pos;
 
-            engine->filter_prev[1] = input + 0.3f * engine->filter_prev[0] + (1.0f - f) * engine->filter_prev[1];
-            engine->filter_prev[0] = input;
-            engine->filter_prev[2] = engine->filter_prev[1] + 0.3f * engine->filter_prev[1] + (1.0f - f) * engine->filter_prev[2];
-            engine->filter_prev[3] = engine->filter_prev[2] + 0.3f * engine->filter_prev[2] + (1.0f - f) * engine->filter_prev[3];
-            engine->filter_prev[4] = engine->filter_prev[3] + 0.3f * engine->filter_prev[3] + (1.0f - f) * engine->filter_prev[4];
+        for (int k = 0; k < count; k++) {
+            moog_engine_t *e = engines[k];
 
-            /* Clamp to prevent blowup */
-            if (engine->filter_prev[4] > 4.0f) engine->filter_prev[4] = 4.0f;
-            if (engine->filter_prev[4] < -4.0f) engine->filter_prev[4] = -4.0f;
+            /* Control pass into the next free group slot */
+            moog_control_t *ctl = &g->ctl[g->count];
+            ctl->rate = control_rate_of(e);
+            control_pass(e, ctl, n);
 
-            sample = engine->filter_prev[4];
+            if (!batch_lane_ok(e) || engine_idle(e, ctl)) {
+                silent[k] &= render_segment(e, ctl, outputs[k] + pos, n, &idle_prev[k]);
+                continue;
+            }
+            if (g->count > 0 && !batch_lane_matches(e, g->engine[0])) {
+                /* Only matching engines share a group: start a new one */
+                int slot = g->count;
+                batch_group_flush(g, n, &idle_prev[group_index[0]]);
+                memcpy(&g->ctl[0], &g->ctl[slot], sizeof(g->ctl[0]));
+            }
+            g->engine[g->count] = e;
+            g->output[g->count] = outputs[k] + pos;
+            group_index[g->count] = k;
+            g->count++;
+            idle_prev[k] = 0;
+            silent[k] = 0;
+            if (g->count == 4) batch_group_flush(g, n, &idle_prev[group_index[0]]);
         }
+        if (g->count > 0) batch_group_flush(g, n, &idle_prev[group_index[0]]);
+    }
+
+    for (int k = 0; k < count; k++) {
+        __atomic_store_n(&engines[k]->silent, silent[k], __ATOMIC_RELAXED);
+    }
+}
 
-        output[i] = sample * engine->master_volume;
+void moog_engine_render_batch(moog_batch_scratch_t *scratch, moog_engine_t *const *engines,
+                              float *const *outputs, int count, int frames) {
+    if (frames <= 0) return;
 
-        engine->counter += 1.0;
+    fp_mode_t fp_mode = fp_mode_enter();
+    for (int first = 0; first < count; first += MOOG_BATCH_MAX) {
+        int n = (count - first > MOOG_BATCH_MAX) ? MOOG_BATCH_MAX : count - first;
+        render_batch_chunk(&scratch->group, engines + first, outputs + first, n, frames);
     }
+    fp_mode_leave(fp_mode);
 }
@@ -22,6 +22,34 @@ extern "C" {
 #define MOOG_SAMPLE_RATE 44100
 #define MOOG_MAX_RENDER 256
 
+/* Modulation is evaluated once per control tick and ramped in between */
+#define MOOG_CONTROL_MAX 32
+#ifndef MOOG_DEFAULT_CONTROL_RATE
+#define MOOG_DEFAULT_CONTROL_RATE 8
+#endif
+
+/* Wavetable oscillator: one table per octave, fewer harmonics per level */
+#define MOOG_WT_SIZE 2048
+#define MOOG_WT_LEVELS 11
+
+/* Ladder coefficients are tabulated over normalized cutoff (0.0 - 1.0) */
+#define MOOG_FILTER_TABLE_SIZE 1024
+
+/* Filter state below this once the amp envelope is off counts as silence
+ * (well under one int16 LSB at the output, far above denormal range) */
+#define MOOG_SILENCE_THRESHOLD 1e-5f
+
+/* Parameter smoothing: fields ramping toward a new value at once */
+#define MOOG_SMOOTH_MAX 16
+
+/* One ramping float field of moog_engine_t */
+typedef struct {
+    uint16_t offset;              /* Byte offset of the field in the engine */
+    int ticks;                    /* Control ticks left */
+    float step;                   /* Change per control tick */
+    float target;
+} moog_smoother_t;
+
 /* Envelope states */
 typedef enum {
     ENV_OFF = 0,
@@ -47,8 +75,127 @@ typedef enum {
     WAVE_COUNT
 } moog_wave_t;
 
-/* RaffoSynth engine state */
+/* Oscillator rendering mode */
+typedef enum {
+    MOOG_OSC_NAIVE = 0,           /* Raw discontinuous waveforms */
+    MOOG_OSC_POLYBLEP,            /* PolyBLEP/BLAMP band-limited corrections */
+    MOOG_OSC_WAVETABLE,           /* Mip-mapped band-limited wavetables */
+    MOOG_OSC_MODE_COUNT
+} moog_osc_mode_t;
+
+#ifndef MOOG_DEFAULT_OSC_MODE
+#define MOOG_DEFAULT_OSC_MODE MOOG_OSC_NAIVE
+#endif
+
+/* Filter modulation accuracy */
+typedef enum {
+    MOOG_FILTER_PER_SAMPLE = 0,   /* Coefficients looked up every sample */
+    MOOG_FILTER_BLOCK,            /* Coefficients ramped across each control tick */
+    MOOG_FILTER_MODE_COUNT
+} moog_filter_mode_t;
+
+/* Ladder oversampling factor (half-band resampler stages) */
+typedef enum {
+    MOOG_FILTER_OS_1X = 0,        /* Ladder runs at the output rate */
+    MOOG_FILTER_OS_2X,            /* One 2x half-band stage */
+    MOOG_FILTER_OS_4X,            /* Two cascaded 2x stages */
+    MOOG_FILTER_OS_COUNT
+} moog_filter_os_t;
+
+/* Half-band resampler history: mirrored ring so the taps read contiguously */
+#define MOOG_HB_LEN 16
+typedef struct {
+    float hist[2 * MOOG_HB_LEN];
+    int pos;
+} moog_hb_ring_t;
+
+/* Polyphony: voice pool size (a voice count of 1 is the mono engine) */
+#define MOOG_MAX_VOICES 8
+
+/* Voice pool in struct-of-arrays layout. Per-voice state is indexed
+ * [...][voice] so four consecutive voices fill one vector. */
+typedef struct {
+    float osc_phase[4][MOOG_MAX_VOICES];
+    float osc_inc[4][MOOG_MAX_VOICES];
+    float filter_prev[5][MOOG_MAX_VOICES];
+    double period[MOOG_MAX_VOICES];
+    double glide_period[MOOG_MAX_VOICES];
+
+    moog_env_state_t amp_env_state[MOOG_MAX_VOICES];
+    float amp_env_level[MOOG_MAX_VOICES];
+    float amp_env_attack_level[MOOG_MAX_VOICES];
+    float amp_env_release_level[MOOG_MAX_VOICES];
+    double amp_env_counter[MOOG_MAX_VOICES];
+
+    moog_env_state_t filt_env_state[MOOG_MAX_VOICES];
+    float filt_env_level[MOOG_MAX_VOICES];
+    float filt_env_attack_level[MOOG_MAX_VOICES];
+    float filt_env_release_level[MOOG_MAX_VOICES];
+    double filt_env_counter[MOOG_MAX_VOICES];
+
+    float ctl_base_inc[MOOG_MAX_VOICES]; /* Last control point per voice */
+    float ctl_amp[MOOG_MAX_VOICES];
+    float ctl_cutoff[MOOG_MAX_VOICES];
+
+    int note[MOOG_MAX_VOICES];
+    float velocity[MOOG_MAX_VOICES];
+
+    /* Allocation: free voices on a stack, sounding voices on a held and
+     * a released list (oldest first), so allocation and stealing are O(1) */
+    int8_t list[MOOG_MAX_VOICES];   /* Held, released or free */
+    int8_t prev[MOOG_MAX_VOICES];
+    int8_t next[MOOG_MAX_VOICES];
+    int8_t head[2];                 /* Held, released; -1 if empty */
+    int8_t tail[2];
+    int8_t free_stack[MOOG_MAX_VOICES];
+    int free_count;
+    int8_t note_voice[128];         /* Voice sounding each note, -1 if none */
+    double last_period;             /* Glide start for the next note */
+} moog_voices_t;
+
+/* Per-sample state of the mono voice: everything a mono render writes
+ * while running, kept together in a few cache lines */
+typedef struct {
+    /* Oscillators and filter */
+    float osc_phase[4];           /* Normalized oscillator phase (0.0 - 1.0) */
+    float osc_inc[4];             /* Phase increment per sample */
+    float filter_prev[6];         /* Filter state variables */
+    uint32_t noise_seed;          /* LFSR noise state */
+
+    /* Control rate */
+    float ctl_base_inc;           /* Last control point: base phase increment */
+    float ctl_amp;                /* Last control point: amp envelope x velocity */
+    float ctl_cutoff;             /* Last control point: normalized cutoff */
+    float lfo_phase;              /* Current LFO phase */
+    double period;                /* Current note period in samples */
+    double glide_period;          /* Glide target period */
+
+    /* Envelopes */
+    moog_env_state_t amp_env_state;
+    float amp_env_level;
+    float amp_env_attack_level;   /* Level captured at attack start (for smooth retrigger) */
+    float amp_env_release_level;  /* Level captured at release start */
+    double amp_env_counter;
+
+    moog_env_state_t filt_env_state;
+    float filt_env_level;
+    float filt_env_attack_level;  /* Level captured at attack start (for smooth retrigger) */
+    float filt_env_release_level; /* Level captured at release start */
+    double filt_env_counter;
+} moog_engine_hot_t;
+
+/* RaffoSynth engine state. The per-sample state comes first, then the
+ * parameters (read once per block or tick) and the key stack. The
+ * resampler history and voice pool at the end are only touched when
+ * filter oversampling or polyphony is on. */
 typedef struct {
+    moog_engine_hot_t hot;
+    int silent;                   /* Last render was skipped as silence; relaxed atomic */
+    int control_rate;             /* Samples per control tick (1 - MOOG_CONTROL_MAX) */
+
+    double amp_env_times[3];      /* Cached attack, decay, release in samples */
+    double filt_env_times[3];
+
     /* Sample rate */
     float sample_rate;
 
@@ -56,15 +203,19 @@ typedef struct {
     moog_wave_t osc_wave[4];      /* Waveform type per oscillator */
     float osc_volume[4];          /* Volume per oscillator (0.0 - 1.0) */
     int   osc_range[4];           /* Octave range offset (-2 to +2) */
+    float osc_ratio[4];           /* Cached range x detune pitch ratio */
     float osc2_detune;            /* Oscillator 2 fine detune (0.0 - 1.0) */
     float osc3_detune;            /* Oscillator 3 fine detune (0.0 - 1.0) */
     float osc4_detune;            /* Oscillator 4 fine detune (0.0 - 1.0) */
+    moog_osc_mode_t osc_mode;     /* Naive or band-limited oscillators */
 
     /* Filter parameters */
     float filter_cutoff;          /* Cutoff frequency (0.0 - 1.0) */
     float filter_resonance;       /* Resonance/emphasis (0.0 - 1.0) */
     float filter_contour;         /* Envelope amount to filter (0.0 - 1.0) */
     float filter_key_follow;      /* Key tracking amount (0.0 - 1.0) */
+    moog_filter_mode_t filter_mode; /* Per-sample or per-tick coefficients */
+    moog_filter_os_t filter_oversample; /* Ladder oversampling (1x, 2x, 4x) */
 
     /* Amplitude envelope (ADSR) */
     float amp_attack;             /* Attack time (0.0 - 1.0) */
@@ -94,30 +245,18 @@ typedef struct {
     float pitch_bend;             /* Current pitch bend (-1.0 to 1.0) */
     float bend_range;             /* Bend range in semitones (0.0 - 1.0, maps to 0-12) */
 
-    /* Internal state - oscillators */
-    double counter;               /* Master sample counter */
-    double period;                /* Current note period in samples */
-    double glide_period;          /* Glide target period */
-    float last_val[5];            /* Last sample values (4 oscillators + noise) */
-
-    /* Internal state - envelopes */
-    moog_env_state_t amp_env_state;
-    float amp_env_level;
-    float amp_env_attack_level;   /* Level captured at attack start (for smooth retrigger) */
-    float amp_env_release_level;  /* Level captured at release start */
-    double amp_env_counter;
-
-    moog_env_state_t filt_env_state;
-    float filt_env_level;
-    float filt_env_attack_level;  /* Level captured at attack start (for smooth retrigger) */
-    float filt_env_release_level; /* Level captured at release start */
-    double filt_env_counter;
+    /* LFO */
+    float lfo_rate;               /* LFO rate (0.0 - 1.0) */
+    float lfo_depth_pitch;        /* LFO depth to pitch */
+    float lfo_depth_filter;       /* LFO depth to filter */
 
-    /* Internal state - filter */
-    float filter_prev[6];         /* Filter state variables */
+    /* Velocity */
+    float velocity;               /* Current note velocity */
+    float velocity_sensitivity;   /* Velocity sensitivity (0.0 - 1.0) */
 
-    /* Internal state - noise */
-    uint32_t noise_seed;          /* LFSR noise state */
+    /* Internal state - smoothing (active ramps only) */
+    moog_smoother_t smooth[MOOG_SMOOTH_MAX];
+    int smooth_count;
 
     /* Internal state - key tracking */
     int current_note;             /* Currently playing MIDI note */
@@ -130,21 +269,41 @@ typedef struct {
     /* Octave transpose (plugin level) */
     int octave_transpose;
 
-    /* LFO */
-    float lfo_rate;               /* LFO rate (0.0 - 1.0) */
-    float lfo_phase;              /* Current LFO phase */
-    float lfo_depth_pitch;        /* LFO depth to pitch */
-    float lfo_depth_filter;       /* LFO depth to filter */
-
-    /* Velocity */
-    float velocity;               /* Current note velocity */
-    float velocity_sensitivity;   /* Velocity sensitivity (0.0 - 1.0) */
+    /* Internal state - oversampled filter */
+    moog_hb_ring_t os_up[2];      /* Upsampler history per 2x stage */
+    moog_hb_ring_t os_down_even[2]; /* Decimator history, even phase */
+    moog_hb_ring_t os_down_odd[2];  /* Decimator history, odd phase */
 
+    /* Polyphony (1 = the mono voice above) */
+    int voice_count;
+    moog_voices_t voices;
 } moog_engine_t;
 
+/* Build shared read-only tables (wavetables, filter coefficients).
+ * Idempotent; call once at plugin load so instance creation does not
+ * pay for it. */
+void moog_engine_tables_init(void);
+
 /* Initialize engine with defaults */
 void moog_engine_init(moog_engine_t *engine);
 
+/* Rebuild cached oscillator pitch ratios (call after changing range/detune) */
+void moog_engine_update_pitch(moog_engine_t *engine);
+
+/* Move a float parameter field of the engine to value over time_ms,
+ * ramping linearly at control rate; time_ms 0 sets it immediately and
+ * cancels any ramp in progress. */
+void moog_engine_set_smoothed(moog_engine_t *engine, float *field, float value, float time_ms);
+
+/* Rebuild cached envelope stage times (call after changing attack, decay or
+ * release of either envelope) */
+void moog_engine_update_envelopes(moog_engine_t *engine);
+
+/* Set the number of voices: 1 is the mono engine with last-note priority,
+ * 2 - MOOG_MAX_VOICES plays notes on a voice pool. Changing it stops all
+ * notes. */
+void moog_engine_set_voices(moog_engine_t *engine, int count);
+
 /* Reset engine state (all notes off) */
 void moog_engine_reset(moog_engine_t *engine);
 
@@ -163,9 +322,37 @@ void moog_engine_mod_wheel(moog_engine_t *engine, float amount);
 /* Render audio block (mono output, caller duplicates to stereo) */
 void moog_engine_render(moog_engine_t *engine, float *output, int frames);
 
+/* Working memory for moog_engine_render_batch (about 64 KB, too large for
+ * an audio thread's stack). Create it once outside the audio thread; one
+ * scratch serves one rendering thread at a time. */
+typedef struct moog_batch_scratch moog_batch_scratch_t;
+
+moog_batch_scratch_t *moog_engine_batch_scratch_create(void);
+void moog_engine_batch_scratch_destroy(moog_batch_scratch_t *scratch);
+
+/* Render several engines over the same frames; outputs[i] receives
+ * engines[i]. Same result as rendering each engine on its own, up to
+ * float rounding, but engines in the default rendering setup share
+ * vector passes (see Batch rendering). */
+void moog_engine_render_batch(moog_batch_scratch_t *scratch, moog_engine_t *const *engines,
+                              float *const *outputs, int count, int frames);
+
 /* All notes off */
 void moog_engine_all_notes_off(moog_engine_t *engine);
 
+/* Largest deviation of the interpolated filter coefficient table from the
+ * exact computation, over `steps` cutoffs per table interval. f and gain
+ * are relative errors; fb is the absolute error of the resonance feedback
+ * (resonance * compensation). Requires moog_engine_tables_init(). */
+typedef struct {
+    float f;
+    float gain;
+    float fb;
+} moog_filter_table_error_t;
+
+void moog_engine_filter_table_error(int oversample, float resonance, int steps,
+                                    moog_filter_table_error_t *err);
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,6 +15,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* Include plugin API */
 extern "C" {
@@ -180,14 +189,31 @@ static const param_def_t g_shadow_params[] = {
     {"vel_sens",      "Vel Sens",      PARAM_TYPE_FLOAT, P_VEL_SENS,      0.0f, 1.0f},
 };
 
+/* Knob smoothing time in ms per param (indexed by P_*), 0 = jump.
+ * Waves and ranges are stepped, detune rebuilds the pitch ratio cache,
+ * and envelope times only matter at the next stage, so those jump. */
+static const float g_param_smooth_ms[P_COUNT] = {
+    0.0f, 20.0f, 0.0f,               /* osc1: wave, volume, range */
+    0.0f, 20.0f, 0.0f, 0.0f,         /* osc2: wave, volume, range, detune */
+    0.0f, 20.0f, 0.0f, 0.0f,         /* osc3: wave, volume, range, detune */
+    0.0f, 20.0f, 0.0f, 0.0f,         /* osc4: wave, volume, range, detune */
+    20.0f,                           /* noise */
+    30.0f, 30.0f, 20.0f, 20.0f,      /* filter: cutoff, res, contour, key_follow */
+    0.0f, 0.0f, 0.0f, 0.0f,          /* amp: A, D, S, R */
+    0.0f, 0.0f, 0.0f, 0.0f,          /* filt: A, D, S, R */
+    0.0f, 20.0f,                     /* glide, volume */
+    20.0f, 20.0f, 20.0f,             /* lfo: rate, pitch, filter */
+    20.0f, 20.0f, 0.0f, 0.0f         /* mod_filt, mod_pitch, bend, vel_sens */
+};
+
 /* =====================================================================
  * Preset system
  * ===================================================================== */
 
-#define MAX_PRESETS 32
+#define PRESET_NAME_LEN 32  /* Including the NUL */
 
 struct MoogPreset {
-    char name[32];
+    char name[PRESET_NAME_LEN];
     float params[P_COUNT];
 };
 
@@ -410,108 +436,1237 @@ static const MoogPreset g_factory_presets[] = {
 
 #define FACTORY_PRESET_COUNT (int)(sizeof(g_factory_presets) / sizeof(g_factory_presets[0]))
 
+/* =====================================================================
+ * Engine settings
+ * Per-instance rendering options. Saved in the patch state, but not
+ * part of presets.
+ * ===================================================================== */
+
+enum {
+    S_OSC_MODE = 0,
+    S_CONTROL_RATE,
+    S_FILTER_MODE,
+    S_FILTER_OVERSAMPLE,
+    S_MIDI_TIMING,
+    S_POLYPHONY,
+    S_COUNT
+};
+
+typedef struct {
+    const char *key;
+    const char *name;
+    int min_val;
+    int max_val;
+} engine_setting_t;
+
+static const engine_setting_t g_engine_settings[S_COUNT] = {
+    {"osc_mode",          "Osc Mode",    0, MOOG_OSC_MODE_COUNT - 1},
+    {"control_rate",      "Ctrl Rate",   1, MOOG_CONTROL_MAX},
+    {"filter_mode",       "Filter Mode", 0, MOOG_FILTER_MODE_COUNT - 1},
+    {"filter_oversample", "Filter OS",   0, MOOG_FILTER_OS_COUNT - 1},
+    {"midi_timing",       "MIDI Timing", 0, 1},
+    {"polyphony",         "Voices",      1, MOOG_MAX_VOICES},
+};
+
+/* =====================================================================
+ * Key lookup
+ * All string keys resolve through hash maps built once at plugin load.
+ * ===================================================================== */
+
+/* Plugin-level keys; engine settings follow from K_SETTING */
+enum {
+    K_PRESET = 0,
+    K_PRESET_COUNT,
+    K_PRESET_NAME,
+    K_NAME,
+    K_OCTAVE_TRANSPOSE,
+    K_ALL_NOTES_OFF,
+    K_IS_SILENT,
+    K_STATE,
+    K_STATE_BIN,
+    K_SAVE_PRESET,
+    K_RENAME_PRESET,
+    K_DELETE_PRESET,
+    K_UI_HIERARCHY,
+    K_CHAIN_PARAMS,
+    K_SETTING
+};
+
+static const char *const g_plugin_key_names[K_SETTING] = {
+    "preset", "preset_count", "preset_name", "name", "octave_transpose",
+    "all_notes_off", "is_silent", "state", "state_bin", "save_preset",
+    "rename_preset", "delete_preset", "ui_hierarchy", "chain_params"
+};
+
+static param_keymap_t g_plugin_keys;
+static param_index_t g_param_index;
+
+static void build_key_maps(void) {
+    memset(&g_plugin_keys, 0, sizeof(g_plugin_keys));
+    for (int i = 0; i < K_SETTING; i++) {
+        param_keymap_add(&g_plugin_keys, g_plugin_key_names[i], i);
+    }
+    for (int i = 0; i < S_COUNT; i++) {
+        param_keymap_add(&g_plugin_keys, g_engine_settings[i].key, K_SETTING + i);
+    }
+    if (param_index_build(&g_param_index, g_shadow_params, PARAM_DEF_COUNT(g_shadow_params)) != 0) {
+        plugin_log("RaffoSynth: param index build failed");
+    }
+}
+
+/* Shadow param by key, or by numeric id as "#<index>" (the P_* index,
+ * listed as "id" in chain_params) */
+static const param_def_t *find_param(const char *key) {
+    if (key[0] == '#' && key[1] >= '0' && key[1] <= '9') {
+        return param_index_find_id(&g_param_index, atoi(key + 1));
+    }
+    return param_index_find(&g_param_index, key);
+}
+
 /* =====================================================================
  * Instance
  * ===================================================================== */
 
+/* Incoming MIDI waits here until the next render_block, which plays each
+ * event at its frame offset. Single producer (on_midi), single consumer
+ * (render_block); size must be a power of two. */
+#define MIDI_QUEUE_SIZE 64
+
+typedef struct {
+    int offset;                   /* Frame offset into the next block */
+    int len;
+    uint8_t msg[3];
+} midi_event_t;
+
+/* Parameter changes from set_param wait here until the next render_block.
+ * Single producer (set_param), single consumer (render_block); size must be
+ * a power of two. Indices past P_COUNT carry non-preset controls. */
+#define PARAM_QUEUE_SIZE 64
+
+typedef struct {
+    int index;                    /* P_* param, or a PQ_* control below */
+    float value;
+} param_update_t;
+
+/* Queue indices past the preset params */
+enum {
+    PQ_OCTAVE = P_COUNT,
+    PQ_ALL_NOTES_OFF,
+    PQ_SETTING                    /* + S_* engine setting */
+};
+
+/* Each queue index also has a bit in param_dirty */
+#define PQ_COUNT (PQ_SETTING + S_COUNT)
+static_assert(PQ_COUNT < 64, "param_dirty needs one bit per queue index");
+
+#define PARAM_BIT(index) ((uint64_t)1 << (index))
+#define PARAM_DIRTY_ALL ((PARAM_BIT(PQ_COUNT) - 1) & ~PARAM_BIT(PQ_ALL_NOTES_OFF))
+
+/* Preset bank and names: read on preset changes and host queries only.
+ * The factory bank is shared read-only by all instances; user presets come
+ * from the library and are read when selected. */
 typedef struct {
     char module_dir[256];
-    moog_engine_t engine;
-    int current_preset;
+    char preset_name[PRESET_NAME_LEN];
     int preset_count;
-    char preset_name[64];
-    float params[P_COUNT];
-    MoogPreset presets[MAX_PRESETS];
+    const MoogPreset *presets;        /* Shared factory bank, preset_count entries */
+    struct preset_library *library;   /* User presets after the slots; NULL until indexed */
+    struct preset_worker *worker;     /* Preset file writer; NULL until first used */
+    int library_stale;                /* Set by the worker after changing files */
+    int select_by_name;               /* Select pending_name once last_job succeeds */
+    unsigned int last_job;            /* Queue position of the last preset job */
+    char pending_name[PRESET_NAME_LEN];
+} moog_instance_cold_t;
+
+struct preset_library;
+struct preset_worker;
+
+/* Render-path state first; the control-side copy and the cold preset bank
+ * follow, so a render touches one compact region */
+typedef struct {
+    moog_engine_t engine;
     float output_gain;
+
+    /* Parameter updates */
+    param_update_t param_queue[PARAM_QUEUE_SIZE];
+    unsigned int param_head;      /* Written by set_param */
+    unsigned int param_tail;      /* Written by render_block */
+    uint64_t param_dirty;         /* Values to re-apply from the control-side copy */
+
+    /* MIDI scheduling */
+    midi_event_t midi_queue[MIDI_QUEUE_SIZE];
+    unsigned int midi_head;       /* Written by on_midi */
+    unsigned int midi_tail;       /* Written by render_block */
+    int64_t block_start_ns;       /* Monotonic time the last block started */
+    int block_frames;             /* Length of the last block */
+    float mono_buf[256];          /* Engine output for the block being rendered */
+
+    /* Control side */
+    int current_preset;
+    float params[P_COUNT];        /* Control-side copy; the engine follows via the queue */
     int octave_transpose;
+    int settings[S_COUNT];        /* Control-side engine settings */
+
+    moog_instance_cold_t cold;
 } moog_instance_t;
 
 /* Forward declarations */
-static void apply_params_to_engine(moog_instance_t *inst);
 static void apply_preset(moog_instance_t *inst, int preset_idx);
+static int preset_total(moog_instance_t *inst);
+static const MoogPreset *preset_lookup(moog_instance_t *inst, int preset_idx, MoogPreset *scratch);
 
 /* =====================================================================
  * Parameter application
+ * set_param only writes the control-side copy (params, settings, octave)
+ * and queues the change. render_block drains the queue before rendering,
+ * so engine fields are only ever written from the audio thread.
  * ===================================================================== */
 
-static void apply_params_to_engine(moog_instance_t *inst) {
-    moog_engine_t *e = &inst->engine;
+/* The control-side copy is read by the audio thread on resync, so shared
+ * fields are written and read with relaxed atomics (plain loads and stores
+ * on the target, but free of data races). */
+static void store_shared_param(moog_instance_t *inst, int index, float value) {
+    __atomic_store(&inst->params[index], &value, __ATOMIC_RELAXED);
+}
 
-    e->osc_wave[0]       = (moog_wave_t)(int)inst->params[P_OSC1_WAVE];
-    e->osc_volume[0]     = inst->params[P_OSC1_VOLUME];
-    e->osc_range[0]      = (int)inst->params[P_OSC1_RANGE];
+/* Derived engine state to rebuild once after a batch of changes */
+#define DERIVED_PITCH    1        /* Oscillator ratio cache (range, detune) */
+#define DERIVED_ENVELOPE 2        /* Envelope stage times (attack, decay, release) */
 
-    e->osc_wave[1]       = (moog_wave_t)(int)inst->params[P_OSC2_WAVE];
-    e->osc_volume[1]     = inst->params[P_OSC2_VOLUME];
-    e->osc_range[1]      = (int)inst->params[P_OSC2_RANGE];
-    e->osc2_detune       = inst->params[P_OSC2_DETUNE];
+static int store_changed_int(int *field, int value, int derived) {
+    if (*field == value) return 0;
+    *field = value;
+    return derived;
+}
 
-    e->osc_wave[2]       = (moog_wave_t)(int)inst->params[P_OSC3_WAVE];
-    e->osc_volume[2]     = inst->params[P_OSC3_VOLUME];
-    e->osc_range[2]      = (int)inst->params[P_OSC3_RANGE];
-    e->osc3_detune       = inst->params[P_OSC3_DETUNE];
+static int store_changed_float(float *field, float value, int derived) {
+    if (*field == value) return 0;
+    *field = value;
+    return derived;
+}
 
-    e->osc_wave[3]       = (moog_wave_t)(int)inst->params[P_OSC4_WAVE];
-    e->osc_volume[3]     = inst->params[P_OSC4_VOLUME];
-    e->osc_range[3]      = (int)inst->params[P_OSC4_RANGE];
-    e->osc4_detune       = inst->params[P_OSC4_DETUNE];
+/* Write one param into the engine, ramping it over its smoothing time when
+ * smooth is set. Returns the DERIVED_* state the change invalidates. */
+static int apply_param_to_engine(moog_engine_t *e, int index, float v, int smooth) {
+    float ms = smooth ? g_param_smooth_ms[index] : 0.0f;
+
+    switch (index) {
+        case P_OSC1_WAVE:        e->osc_wave[0] = (moog_wave_t)(int)v; break;
+        case P_OSC1_VOLUME:      moog_engine_set_smoothed(e, &e->osc_volume[0], v, ms); break;
+        case P_OSC1_RANGE:       return store_changed_int(&e->osc_range[0], (int)v, DERIVED_PITCH);
+
+        case P_OSC2_WAVE:        e->osc_wave[1] = (moog_wave_t)(int)v; break;
+        case P_OSC2_VOLUME:      moog_engine_set_smoothed(e, &e->osc_volume[1], v, ms); break;
+        case P_OSC2_RANGE:       return store_changed_int(&e->osc_range[1], (int)v, DERIVED_PITCH);
+        case P_OSC2_DETUNE:      return store_changed_float(&e->osc2_detune, v, DERIVED_PITCH);
+
+        case P_OSC3_WAVE:        e->osc_wave[2] = (moog_wave_t)(int)v; break;
+        case P_OSC3_VOLUME:      moog_engine_set_smoothed(e, &e->osc_volume[2], v, ms); break;
+        case P_OSC3_RANGE:       return store_changed_int(&e->osc_range[2], (int)v, DERIVED_PITCH);
+        case P_OSC3_DETUNE:      return store_changed_float(&e->osc3_detune, v, DERIVED_PITCH);
+
+        case P_OSC4_WAVE:        e->osc_wave[3] = (moog_wave_t)(int)v; break;
+        case P_OSC4_VOLUME:      moog_engine_set_smoothed(e, &e->osc_volume[3], v, ms); break;
+        case P_OSC4_RANGE:       return store_changed_int(&e->osc_range[3], (int)v, DERIVED_PITCH);
+        case P_OSC4_DETUNE:      return store_changed_float(&e->osc4_detune, v, DERIVED_PITCH);
+
+        case P_NOISE:            moog_engine_set_smoothed(e, &e->noise_volume, v, ms); break;
+
+        case P_FILTER_CUTOFF:    moog_engine_set_smoothed(e, &e->filter_cutoff, v, ms); break;
+        case P_FILTER_RESONANCE: moog_engine_set_smoothed(e, &e->filter_resonance, v, ms); break;
+        case P_FILTER_CONTOUR:   moog_engine_set_smoothed(e, &e->filter_contour, v, ms); break;
+        case P_FILTER_KEY_FOLLOW: moog_engine_set_smoothed(e, &e->filter_key_follow, v, ms); break;
+
+        case P_AMP_ATTACK:       return store_changed_float(&e->amp_attack, v, DERIVED_ENVELOPE);
+        case P_AMP_DECAY:        return store_changed_float(&e->amp_decay, v, DERIVED_ENVELOPE);
+        case P_AMP_SUSTAIN:      e->amp_sustain = v; break;
+        case P_AMP_RELEASE:      return store_changed_float(&e->amp_release, v, DERIVED_ENVELOPE);
+
+        case P_FILT_ATTACK:      return store_changed_float(&e->filt_attack, v, DERIVED_ENVELOPE);
+        case P_FILT_DECAY:       return store_changed_float(&e->filt_decay, v, DERIVED_ENVELOPE);
+        case P_FILT_SUSTAIN:     e->filt_sustain = v; break;
+        case P_FILT_RELEASE:     return store_changed_float(&e->filt_release, v, DERIVED_ENVELOPE);
+
+        case P_GLIDE:            e->glide = v; break;
+        case P_MASTER_VOLUME:    moog_engine_set_smoothed(e, &e->master_volume, v, ms); break;
+
+        case P_LFO_RATE:         moog_engine_set_smoothed(e, &e->lfo_rate, v, ms); break;
+        case P_LFO_PITCH:        moog_engine_set_smoothed(e, &e->lfo_depth_pitch, v, ms); break;
+        case P_LFO_FILTER:       moog_engine_set_smoothed(e, &e->lfo_depth_filter, v, ms); break;
+
+        case P_MOD_FILTER:       moog_engine_set_smoothed(e, &e->mod_to_filter, v, ms); break;
+        case P_MOD_PITCH:        moog_engine_set_smoothed(e, &e->mod_to_pitch, v, ms); break;
+        case P_BEND_RANGE:       e->bend_range = v; break;
+        case P_VEL_SENS:         e->velocity_sensitivity = v; break;
+    }
+    return 0;
+}
 
-    e->noise_volume      = inst->params[P_NOISE];
+static void apply_engine_setting(moog_engine_t *e, int setting, int value) {
+    switch (setting) {
+        case S_OSC_MODE:          e->osc_mode = (moog_osc_mode_t)value; break;
+        case S_CONTROL_RATE:      e->control_rate = value; break;
+        case S_FILTER_MODE:       e->filter_mode = (moog_filter_mode_t)value; break;
+        case S_FILTER_OVERSAMPLE: e->filter_oversample = (moog_filter_os_t)value; break;
+        case S_MIDI_TIMING:       break;  /* Read by on_midi from settings */
+        case S_POLYPHONY:         moog_engine_set_voices(e, value); break;
+    }
+}
 
-    e->filter_cutoff     = inst->params[P_FILTER_CUTOFF];
-    e->filter_resonance  = inst->params[P_FILTER_RESONANCE];
-    e->filter_contour    = inst->params[P_FILTER_CONTOUR];
-    e->filter_key_follow = inst->params[P_FILTER_KEY_FOLLOW];
+/* Apply one queue index (param, octave, notes off or setting) */
+static int apply_update(moog_instance_t *inst, int index, float value, int smooth) {
+    moog_engine_t *e = &inst->engine;
 
-    e->amp_attack        = inst->params[P_AMP_ATTACK];
-    e->amp_decay         = inst->params[P_AMP_DECAY];
-    e->amp_sustain       = inst->params[P_AMP_SUSTAIN];
-    e->amp_release       = inst->params[P_AMP_RELEASE];
+    if (index < P_COUNT) return apply_param_to_engine(e, index, value, smooth);
 
-    e->filt_attack       = inst->params[P_FILT_ATTACK];
-    e->filt_decay        = inst->params[P_FILT_DECAY];
-    e->filt_sustain      = inst->params[P_FILT_SUSTAIN];
-    e->filt_release      = inst->params[P_FILT_RELEASE];
+    if (index == PQ_OCTAVE) {
+        e->octave_transpose = (int)value;
+    } else if (index == PQ_ALL_NOTES_OFF) {
+        moog_engine_all_notes_off(e);
+    } else {
+        apply_engine_setting(e, index - PQ_SETTING, (int)value);
+    }
+    return 0;
+}
 
-    e->glide             = inst->params[P_GLIDE];
-    e->master_volume     = inst->params[P_MASTER_VOLUME];
+/* Current control-side value for a queue index */
+static float load_shared(moog_instance_t *inst, int index) {
+    if (index < P_COUNT) {
+        float v;
+        __atomic_load(&inst->params[index], &v, __ATOMIC_RELAXED);
+        return v;
+    }
+    if (index == PQ_OCTAVE) return (float)__atomic_load_n(&inst->octave_transpose, __ATOMIC_RELAXED);
+    if (index >= PQ_SETTING) {
+        return (float)__atomic_load_n(&inst->settings[index - PQ_SETTING], __ATOMIC_RELAXED);
+    }
+    return 0.0f;
+}
+
+static void mark_dirty(moog_instance_t *inst, uint64_t bits) {
+    if (bits) __atomic_fetch_or(&inst->param_dirty, bits, __ATOMIC_RELEASE);
+}
 
-    e->lfo_rate          = inst->params[P_LFO_RATE];
-    e->lfo_depth_pitch   = inst->params[P_LFO_PITCH];
-    e->lfo_depth_filter  = inst->params[P_LFO_FILTER];
+/* Control side: queue one change for the audio thread. If the queue is
+ * full, mark it dirty instead; the control-side copy already holds the new
+ * value, so the next block re-applies it from there. */
+static void queue_param(moog_instance_t *inst, int index, float value) {
+    unsigned int head = inst->param_head;
+    unsigned int tail = __atomic_load_n(&inst->param_tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= PARAM_QUEUE_SIZE) {
+        mark_dirty(inst, PARAM_BIT(index));
+        return;
+    }
 
-    e->mod_to_filter     = inst->params[P_MOD_FILTER];
-    e->mod_to_pitch      = inst->params[P_MOD_PITCH];
-    e->bend_range        = inst->params[P_BEND_RANGE];
-    e->velocity_sensitivity = inst->params[P_VEL_SENS];
+    param_update_t *u = &inst->param_queue[head & (PARAM_QUEUE_SIZE - 1)];
+    u->index = index;
+    u->value = value;
+    __atomic_store_n(&inst->param_head, head + 1, __ATOMIC_RELEASE);
 }
 
-static void apply_preset(moog_instance_t *inst, int preset_idx) {
-    if (preset_idx < 0 || preset_idx >= inst->preset_count) return;
+/* Audio side: apply queued changes, then the dirty values. Queued entries
+ * are never newer than the control-side copy, so dirty values go last and
+ * jump rather than ramp. Derived state is rebuilt once for the batch. */
+static void drain_param_queue(moog_instance_t *inst) {
+    int derived = 0;
+    unsigned int tail = inst->param_tail;
+    unsigned int head = __atomic_load_n(&inst->param_head, __ATOMIC_ACQUIRE);
+
+    for (; tail != head; tail++) {
+        const param_update_t *u = &inst->param_queue[tail & (PARAM_QUEUE_SIZE - 1)];
+        derived |= apply_update(inst, u->index, u->value, 1);
+    }
+    __atomic_store_n(&inst->param_tail, tail, __ATOMIC_RELEASE);
+
+    uint64_t dirty = __atomic_exchange_n(&inst->param_dirty, 0, __ATOMIC_ACQUIRE);
+    while (dirty) {
+        int index = __builtin_ctzll(dirty);
+        dirty &= dirty - 1;
+        derived |= apply_update(inst, index, load_shared(inst, index), 0);
+    }
 
-    MoogPreset *p = &inst->presets[preset_idx];
-    memcpy(inst->params, p->params, sizeof(float) * P_COUNT);
-    snprintf(inst->preset_name, sizeof(inst->preset_name), "%s", p->name);
+    if (derived & DERIVED_PITCH) moog_engine_update_pitch(&inst->engine);
+    if (derived & DERIVED_ENVELOPE) moog_engine_update_envelopes(&inst->engine);
+}
+
+static void apply_preset(moog_instance_t *inst, int preset_idx) {
+    MoogPreset loaded;
+    const MoogPreset *p = preset_lookup(inst, preset_idx, &loaded);
+    if (!p) return;
+
+    /* Only params that differ from the current ones are re-applied */
+    uint64_t dirty = 0;
+    for (int i = 0; i < P_COUNT; i++) {
+        if (p->params[i] != inst->params[i]) {
+            store_shared_param(inst, i, p->params[i]);
+            dirty |= PARAM_BIT(i);
+        }
+    }
+    snprintf(inst->cold.preset_name, sizeof(inst->cold.preset_name), "%s", p->name);
     inst->current_preset = preset_idx;
 
-    apply_params_to_engine(inst);
+    mark_dirty(inst, dirty);
+}
+
+static int clamp_setting(int setting, int value) {
+    if (value < g_engine_settings[setting].min_val) value = g_engine_settings[setting].min_val;
+    if (value > g_engine_settings[setting].max_val) value = g_engine_settings[setting].max_val;
+    return value;
+}
+
+static void set_engine_setting(moog_instance_t *inst, int setting, int value) {
+    if (setting < 0 || setting >= S_COUNT) return;
+    value = clamp_setting(setting, value);
+
+    __atomic_store_n(&inst->settings[setting], value, __ATOMIC_RELAXED);
+    queue_param(inst, PQ_SETTING + setting, (float)value);
 }
 
 /* =====================================================================
- * JSON helper
+ * JSON helpers
  * ===================================================================== */
 
-static int json_get_number(const char *json, const char *key, float *out) {
-    char search[64];
-    snprintf(search, sizeof(search), "\"%s\":", key);
-    const char *pos = strstr(json, search);
-    if (!pos) return -1;
-    pos += strlen(search);
-    while (*pos == ' ') pos++;
-    *out = (float)atof(pos);
+/* Number of characters in the JSON string starting at p (just past the
+ * opening quote), or -1 if it is unterminated */
+static int json_string_len(const char *p) {
+    const char *start = p;
+    while (*p && *p != '"') {
+        if (*p == '\\' && p[1]) p++;
+        p++;
+    }
+    return *p ? (int)(p - start) : -1;
+}
+
+static const char *json_skip_ws(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+    return p;
+}
+
+/* Skip one non-numeric value: string, literal, or nested object/array.
+ * Returns: the end of the value, or NULL if it is missing or malformed */
+static const char *json_skip_value(const char *p) {
+    if (*p == ',' || *p == '}' || *p == ']' || !*p) return NULL;
+
+    int depth = 0;
+    do {
+        if (*p == '"') {
+            int len = json_string_len(p + 1);
+            if (len < 0) return NULL;
+            p += len + 2;
+            continue;
+        }
+        if (*p == '{' || *p == '[') depth++;
+        else if (*p == '}' || *p == ']') {
+            if (depth == 0) return p;
+            depth--;
+        }
+        else if (*p == ',' && depth == 0) return p;
+        else if (!*p) return NULL;
+        p++;
+    } while (depth > 0 || (*p != ',' && *p != '}' && *p != ']'));
+    return p;
+}
+
+typedef void (*json_number_fn)(void *ctx, const char *key, float value);
+
+/* Walk a JSON object once, calling fn for each numeric member; other
+ * members are skipped. Keys longer than 63 characters are ignored.
+ * Returns 0, or -1 if the input is malformed (members before the error
+ * have already been reported). */
+static int json_for_each_number(const char *json, json_number_fn fn, void *ctx) {
+    const char *p = json_skip_ws(json);
+    if (*p != '{') return -1;
+    p = json_skip_ws(p + 1);
+    if (*p == '}') return 0;
+
+    for (;;) {
+        if (*p != '"') return -1;
+        int len = json_string_len(p + 1);
+        if (len < 0) return -1;
+
+        char key[64];
+        int usable = (len < (int)sizeof(key));
+        if (usable) {
+            memcpy(key, p + 1, len);
+            key[len] = '\0';
+        }
+        p = json_skip_ws(p + len + 2);
+        if (*p != ':') return -1;
+        p = json_skip_ws(p + 1);
+
+        char *end;
+        float value = strtof(p, &end);
+        if (end != p) {
+            if (usable) fn(ctx, key, value);
+            p = end;
+        } else {
+            p = json_skip_value(p);
+            if (!p) return -1;
+        }
+
+        p = json_skip_ws(p);
+        if (*p == '}') return 0;
+        if (*p != ',') return -1;
+        p = json_skip_ws(p + 1);
+    }
+}
+
+/* =====================================================================
+ * State restore
+ * ===================================================================== */
+
+/* Values found in a state string, applied in a fixed order once parsed */
+typedef struct {
+    int preset;                   /* -1 if absent */
+    int has_octave;
+    int octave;
+    int settings[S_COUNT];
+    uint32_t has_setting;         /* Bit per S_* */
+    float params[P_COUNT];
+    uint64_t has_param;           /* PARAM_BIT per P_* */
+} state_values_t;
+
+static void state_collect(void *ctx, const char *key, float value) {
+    state_values_t *sv = (state_values_t *)ctx;
+    int k = param_keymap_find(&g_plugin_keys, key);
+
+    if (k == K_PRESET) {
+        sv->preset = (int)value;
+    } else if (k == K_OCTAVE_TRANSPOSE) {
+        sv->has_octave = 1;
+        sv->octave = (int)value;
+    } else if (k >= K_SETTING) {
+        sv->settings[k - K_SETTING] = clamp_setting(k - K_SETTING, (int)value);
+        sv->has_setting |= 1u << (k - K_SETTING);
+    } else if (k < 0) {
+        const param_def_t *def = param_index_find(&g_param_index, key);
+        if (def) {
+            sv->params[def->index] = param_helper_clamp(def, value);
+            sv->has_param |= PARAM_BIT(def->index);
+        }
+    }
+}
+
+static void state_values_init(state_values_t *sv) {
+    sv->preset = -1;
+    sv->has_octave = 0;
+    sv->has_setting = 0;
+    sv->has_param = 0;
+}
+
+/* Apply the preset first so the individual params saved with it override
+ * the preset's values */
+static void apply_state_values(moog_instance_t *inst, const state_values_t *sv) {
+    if (sv->preset >= 0) {
+        inst->cold.select_by_name = 0;
+        apply_preset(inst, sv->preset);
+    }
+
+    uint64_t dirty = 0;
+    if (sv->has_octave && sv->octave != inst->octave_transpose) {
+        __atomic_store_n(&inst->octave_transpose, sv->octave, __ATOMIC_RELAXED);
+        dirty |= PARAM_BIT(PQ_OCTAVE);
+    }
+    for (int i = 0; i < S_COUNT; i++) {
+        if ((sv->has_setting & (1u << i)) && sv->settings[i] != inst->settings[i]) {
+            __atomic_store_n(&inst->settings[i], sv->settings[i], __ATOMIC_RELAXED);
+            dirty |= PARAM_BIT(PQ_SETTING + i);
+        }
+    }
+    for (int i = 0; i < P_COUNT; i++) {
+        if ((sv->has_param & PARAM_BIT(i)) && sv->params[i] != inst->params[i]) {
+            store_shared_param(inst, i, sv->params[i]);
+            dirty |= PARAM_BIT(i);
+        }
+    }
+    mark_dirty(inst, dirty);
+}
+
+static void restore_state(moog_instance_t *inst, const char *json) {
+    state_values_t sv;
+    state_values_init(&sv);
+
+    if (json_for_each_number(json, state_collect, &sv) != 0) {
+        plugin_log("RaffoSynth: malformed state, restoring the values before the error");
+    }
+    apply_state_values(inst, &sv);
+}
+
+/* =====================================================================
+ * Binary state
+ * "state_bin" holds the same values as "state" in a compact form for fast
+ * patch switching: base64 of
+ *   "RS", version (u8), entry count (u8), preset (s16 LE),
+ *   then per entry: id (u8) and value (f32 LE).
+ * Ids are the P_* index for params, STATE_BIN_ID_OCTAVE and
+ * STATE_BIN_ID_SETTING + S_*, so both enums must only ever grow at the end.
+ * Values round-trip exactly. Readers skip unknown ids, so new params do
+ * not need a version bump.
+ * ===================================================================== */
+
+#define STATE_BIN_VERSION     1
+#define STATE_BIN_HEADER      6
+#define STATE_BIN_ENTRY       5
+#define STATE_BIN_ID_OCTAVE   0x80
+#define STATE_BIN_ID_SETTING  0x90
+#define STATE_BIN_MAX (STATE_BIN_HEADER + (P_COUNT + 1 + S_COUNT) * STATE_BIN_ENTRY)
+
+static const char g_base64_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* Returns: characters written (NUL-terminated), or -1 if out is too small */
+static int base64_encode(const uint8_t *in, int len, char *out, int out_len) {
+    int needed = (len + 2) / 3 * 4;
+    if (needed + 1 > out_len) return -1;
+
+    char *o = out;
+    for (int i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < len) v |= in[i + 2];
+        *o++ = g_base64_chars[(v >> 18) & 63];
+        *o++ = g_base64_chars[(v >> 12) & 63];
+        *o++ = (i + 1 < len) ? g_base64_chars[(v >> 6) & 63] : '=';
+        *o++ = (i + 2 < len) ? g_base64_chars[v & 63] : '=';
+    }
+    *o = '\0';
+    return needed;
+}
+
+static int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+/* Returns: bytes decoded, or -1 on invalid input or overflow */
+static int base64_decode(const char *in, uint8_t *out, int out_len) {
+    int len = 0;
+    uint32_t acc = 0;
+    int bits = 0;
+
+    for (; *in && *in != '='; in++) {
+        int v = base64_value(*in);
+        if (v < 0) return -1;
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (len >= out_len) return -1;
+            out[len++] = (uint8_t)(acc >> bits);
+        }
+    }
+    return len;
+}
+
+static float get_f32le(const uint8_t *p) {
+    uint32_t u = (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                 ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    float value;
+    memcpy(&value, &u, sizeof(value));
+    return value;
+}
+
+static void put_f32le(uint8_t *p, float value) {
+    uint32_t u;
+    memcpy(&u, &value, sizeof(u));
+    p[0] = (uint8_t)u;
+    p[1] = (uint8_t)(u >> 8);
+    p[2] = (uint8_t)(u >> 16);
+    p[3] = (uint8_t)(u >> 24);
+}
+
+static uint8_t *put_entry(uint8_t *p, int id, float value) {
+    p[0] = (uint8_t)id;
+    put_f32le(p + 1, value);
+    return p + STATE_BIN_ENTRY;
+}
+
+/* Returns: bytes written to bin (STATE_BIN_MAX at most) */
+static int state_bin_write(const moog_instance_t *inst, uint8_t *bin) {
+    int count = P_COUNT + 1 + S_COUNT;
+    bin[0] = 'R';
+    bin[1] = 'S';
+    bin[2] = STATE_BIN_VERSION;
+    bin[3] = (uint8_t)count;
+    bin[4] = (uint8_t)(inst->current_preset & 0xFF);
+    bin[5] = (uint8_t)((inst->current_preset >> 8) & 0xFF);
+
+    uint8_t *p = bin + STATE_BIN_HEADER;
+    p = put_entry(p, STATE_BIN_ID_OCTAVE, (float)inst->octave_transpose);
+    for (int i = 0; i < S_COUNT; i++) {
+        p = put_entry(p, STATE_BIN_ID_SETTING + i, (float)inst->settings[i]);
+    }
+    for (int i = 0; i < P_COUNT; i++) {
+        p = put_entry(p, i, inst->params[i]);
+    }
+    return (int)(p - bin);
+}
+
+static void restore_state_bin(moog_instance_t *inst, const char *text) {
+    uint8_t bin[STATE_BIN_MAX + 64 * STATE_BIN_ENTRY];  /* Room for newer writers */
+    int len = base64_decode(text, bin, sizeof(bin));
+
+    if (len < STATE_BIN_HEADER || bin[0] != 'R' || bin[1] != 'S' ||
+        bin[2] != STATE_BIN_VERSION ||
+        len < STATE_BIN_HEADER + bin[3] * STATE_BIN_ENTRY) {
+        plugin_log("RaffoSynth: invalid or unsupported state_bin");
+        return;
+    }
+
+    state_values_t sv;
+    state_values_init(&sv);
+    sv.preset = (int16_t)(bin[4] | (bin[5] << 8));
+
+    const uint8_t *p = bin + STATE_BIN_HEADER;
+    for (int n = 0; n < bin[3]; n++, p += STATE_BIN_ENTRY) {
+        float value = get_f32le(p + 1);
+        int id = p[0];
+
+        if (id == STATE_BIN_ID_OCTAVE) {
+            sv.has_octave = 1;
+            sv.octave = (int)value;
+        } else if (id >= STATE_BIN_ID_SETTING && id < STATE_BIN_ID_SETTING + S_COUNT) {
+            int setting = id - STATE_BIN_ID_SETTING;
+            sv.settings[setting] = clamp_setting(setting, (int)value);
+            sv.has_setting |= 1u << setting;
+        } else {
+            const param_def_t *def = param_index_find_id(&g_param_index, id);
+            if (def) {
+                sv.params[def->index] = param_helper_clamp(def, value);
+                sv.has_param |= PARAM_BIT(def->index);
+            }
+        }
+    }
+    apply_state_values(inst, &sv);
+}
+
+/* =====================================================================
+ * User preset library
+ * Presets past the factory slots come from module_dir:
+ *   presets.bank      packed bank, memory-mapped read-only
+ *   presets/<name>.rsp  one preset per file, named after the file
+ * Both use the same format, all little-endian:
+ *   "RSPB", version (u8), params per record (u8), record count (u16),
+ *   then per record: name (32 bytes, NUL-padded) and that many f32 values
+ *   in P_* order.
+ * The index is built on first use and holds names only; a preset's values
+ * are read when it is selected. Records with fewer params than P_COUNT
+ * take the rest from Init, so P_* must only ever grow at the end.
+ * ===================================================================== */
+
+#define PRESET_FILE_VERSION  1
+#define PRESET_FILE_HEADER   8
+#define PRESET_FILE_EXT      ".rsp"
+#define LIBRARY_MAX_PRESETS  4096
+
+typedef struct preset_library {
+    const uint8_t *bank;          /* Mapping of presets.bank, or NULL */
+    size_t bank_size;
+    int bank_count;
+    int bank_params;              /* Values per bank record */
+    char (*files)[PRESET_NAME_LEN];  /* Sorted presets/ names */
+    int file_count;
+} preset_library_t;
+
+/* Returns: record count, or -1 if data is not a valid preset file */
+static int preset_file_check(const uint8_t *data, size_t size, int *params) {
+    if (size < PRESET_FILE_HEADER || memcmp(data, "RSPB", 4) != 0 ||
+        data[4] > PRESET_FILE_VERSION || data[5] == 0) {
+        return -1;
+    }
+    int count = data[6] | (data[7] << 8);
+    size_t record = PRESET_NAME_LEN + (size_t)data[5] * 4;
+    if (size < PRESET_FILE_HEADER + record * count) return -1;
+    *params = data[5];
+    return count;
+}
+
+static void preset_file_record(const uint8_t *data, int params, int record, MoogPreset *out) {
+    const uint8_t *p = data + PRESET_FILE_HEADER + (size_t)record * (PRESET_NAME_LEN + params * 4);
+    memcpy(out->name, p, PRESET_NAME_LEN);
+    out->name[PRESET_NAME_LEN - 1] = '\0';
+    p += PRESET_NAME_LEN;
+
+    for (int i = 0; i < P_COUNT; i++) {
+        float v = g_factory_presets[0].params[i];
+        if (i < params) {
+            float f = get_f32le(p + i * 4);
+            if (f == f) v = f;   /* Skips NaN */
+        }
+        const param_def_t *def = param_index_find_id(&g_param_index, i);
+        out->params[i] = def ? param_helper_clamp(def, v) : v;
+    }
+}
+
+static void library_map_bank(preset_library_t *lib, const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            int count = preset_file_check((const uint8_t *)map, (size_t)st.st_size, &lib->bank_params);
+            if (count >= 0) {
+                lib->bank = (const uint8_t *)map;
+                lib->bank_size = (size_t)st.st_size;
+                lib->bank_count = count;
+            } else {
+                munmap(map, (size_t)st.st_size);
+                plugin_log("RaffoSynth: ignoring invalid presets.bank");
+            }
+        }
+    }
+    close(fd);
+}
+
+static int name_compare(const void *a, const void *b) {
+    return strcmp((const char *)a, (const char *)b);
+}
+
+/* Collects the names only; files are opened when selected */
+static void library_scan_dir(preset_library_t *lib, const char *path, int limit) {
+    DIR *dir = opendir(path);
+    if (!dir) return;
+
+    int capacity = 0;
+    const size_t ext_len = sizeof(PRESET_FILE_EXT) - 1;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL && lib->file_count < limit) {
+        size_t len = strlen(ent->d_name);
+        if (len <= ext_len || len - ext_len >= PRESET_NAME_LEN ||
+            strcmp(ent->d_name + len - ext_len, PRESET_FILE_EXT) != 0) {
+            continue;
+        }
+        if (lib->file_count == capacity) {
+            int grown = capacity ? capacity * 2 : 32;
+            void *files = realloc(lib->files, (size_t)grown * PRESET_NAME_LEN);
+            if (!files) break;
+            lib->files = (char (*)[PRESET_NAME_LEN])files;
+            capacity = grown;
+        }
+        memcpy(lib->files[lib->file_count], ent->d_name, len - ext_len);
+        lib->files[lib->file_count][len - ext_len] = '\0';
+        lib->file_count++;
+    }
+    closedir(dir);
+
+    if (lib->file_count > 1) {
+        qsort(lib->files, (size_t)lib->file_count, PRESET_NAME_LEN, name_compare);
+    }
+}
+
+static void library_release(moog_instance_t *inst) {
+    preset_library_t *lib = inst->cold.library;
+    if (!lib) return;
+    if (lib->bank) munmap((void *)lib->bank, lib->bank_size);
+    free(lib->files);
+    free(lib);
+    inst->cold.library = NULL;
+}
+
+static preset_library_t *library_get(moog_instance_t *inst);
+static int preset_job_done(moog_instance_t *inst, unsigned int job, int *failed);
+
+/* Returns: the index of file name in lib->files, or -1 */
+static int library_find(const preset_library_t *lib, const char *name) {
+    const char (*found)[PRESET_NAME_LEN] = (const char (*)[PRESET_NAME_LEN])bsearch(
+        name, lib->files, (size_t)lib->file_count, PRESET_NAME_LEN, name_compare);
+    return found ? (int)(found - lib->files) : -1;
+}
+
+/* The files changed: re-index, select the file a queued save or rename
+ * has created, and keep the current user file selected by name */
+static void library_refresh(moog_instance_t *inst) {
+    preset_library_t *old = inst->cold.library;
+    int file_start = inst->cold.preset_count + (old ? old->bank_count : 0);
+    int was_file = old && inst->current_preset >= file_start;
+
+    library_release(inst);
+    preset_library_t *lib = library_get(inst);
+    if (!lib) return;
+
+    int base = inst->cold.preset_count + lib->bank_count;
+    int total = base + lib->file_count;
+    int failed;
+    if (inst->cold.select_by_name && preset_job_done(inst, inst->cold.last_job, &failed)) {
+        /* If the job failed the previous selection is kept */
+        inst->cold.select_by_name = 0;
+        int idx = failed ? -1 : library_find(lib, inst->cold.pending_name);
+        if (idx >= 0) {
+            memcpy(inst->cold.preset_name, inst->cold.pending_name, sizeof(inst->cold.preset_name));
+            inst->current_preset = base + idx;
+            return;
+        }
+    }
+    if (!was_file) return;
+
+    int idx = library_find(lib, inst->cold.preset_name);
+    if (idx >= 0) {
+        inst->current_preset = base + idx;
+    } else {
+        /* The current file is gone: select the preset now at its index */
+        apply_preset(inst, inst->current_preset < total ? inst->current_preset : total - 1);
+    }
+}
+
+/* Returns: the library, indexing it on first use; NULL if out of memory */
+static preset_library_t *library_get(moog_instance_t *inst) {
+    if (__atomic_exchange_n(&inst->cold.library_stale, 0, __ATOMIC_ACQUIRE)) {
+        library_refresh(inst);
+    }
+    if (inst->cold.library) return inst->cold.library;
+
+    preset_library_t *lib = (preset_library_t *)calloc(1, sizeof(preset_library_t));
+    if (!lib) return NULL;
+
+    char path[512];
+    int limit = LIBRARY_MAX_PRESETS;
+    snprintf(path, sizeof(path), "%s/presets.bank", inst->cold.module_dir);
+    library_map_bank(lib, path);
+    if (lib->bank_count > limit) lib->bank_count = limit;
+    limit -= lib->bank_count;
+
+    snprintf(path, sizeof(path), "%s/presets", inst->cold.module_dir);
+    library_scan_dir(lib, path, limit);
+
+    inst->cold.library = lib;
+    return lib;
+}
+
+/* Reads library preset idx into out. Returns: 0 on success, -1 on failure */
+static int library_load(moog_instance_t *inst, preset_library_t *lib, int idx, MoogPreset *out) {
+    if (idx < lib->bank_count) {
+        preset_file_record(lib->bank, lib->bank_params, idx, out);
+        return 0;
+    }
+
+    const char *name = lib->files[idx - lib->bank_count];
+    char path[512];
+    snprintf(path, sizeof(path), "%s/presets/%s" PRESET_FILE_EXT, inst->cold.module_dir, name);
+
+    uint8_t data[PRESET_FILE_HEADER + PRESET_NAME_LEN + 255 * 4];
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    size_t size = fread(data, 1, sizeof(data), f);
+    fclose(f);
+
+    int params;
+    if (preset_file_check(data, size, &params) < 1) return -1;
+    preset_file_record(data, params, 0, out);
+    snprintf(out->name, sizeof(out->name), "%s", name);
     return 0;
 }
 
+/* Returns: slot presets plus library presets */
+static int preset_total(moog_instance_t *inst) {
+    preset_library_t *lib = library_get(inst);
+    int total = inst->cold.preset_count;
+    if (lib) total += lib->bank_count + lib->file_count;
+    return total;
+}
+
+/*
+ * Returns: preset idx, either a slot or a library preset read into scratch;
+ * NULL if idx is out of range or the preset could not be read
+ */
+static const MoogPreset *preset_lookup(moog_instance_t *inst, int preset_idx, MoogPreset *scratch) {
+    if (preset_idx < 0) return NULL;
+    if (preset_idx < inst->cold.preset_count) return &inst->cold.presets[preset_idx];
+
+    preset_library_t *lib = library_get(inst);
+    int idx = preset_idx - inst->cold.preset_count;
+    if (!lib || idx >= lib->bank_count + lib->file_count) return NULL;
+
+    if (library_load(inst, lib, idx, scratch) != 0) {
+        plugin_log("RaffoSynth: could not read user preset");
+        return NULL;
+    }
+    return scratch;
+}
+
+/* =====================================================================
+ * Preset saving
+ * save_preset, rename_preset and delete_preset only queue a job; a worker
+ * thread per instance, started on first use, does the file I/O so neither
+ * the host nor the audio thread waits on flash. Writes go to a temp file
+ * that is synced and renamed over the preset, so a preset file is always
+ * either the old or the new version. Factory and bank presets are
+ * read-only; only presets/ files can be renamed or deleted.
+ * ===================================================================== */
+
+#define PRESET_JOB_QUEUE_SIZE 16  /* Power of two */
+
+enum {
+    PRESET_JOB_SAVE,
+    PRESET_JOB_RENAME,
+    PRESET_JOB_DELETE
+};
+
+typedef struct {
+    int op;
+    char name[PRESET_NAME_LEN];
+    char new_name[PRESET_NAME_LEN];
+    float params[P_COUNT];
+} preset_job_t;
+
+/* Single producer (set_param), single consumer (the worker) */
+typedef struct preset_worker {
+    pthread_t thread;
+    sem_t wake;
+    moog_instance_t *inst;
+    preset_job_t jobs[PRESET_JOB_QUEUE_SIZE];
+    unsigned int head;            /* Written by set_param */
+    unsigned int tail;            /* Written by the worker */
+    unsigned int last_failed;     /* Queue position of the last failed job */
+    int quit;
+} preset_worker_t;
+
+/* Names become file names, so no path separators or hidden files */
+static int preset_name_valid(const char *name) {
+    size_t len = strlen(name);
+    if (len == 0 || len >= PRESET_NAME_LEN || name[0] == '.') return 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)name[i];
+        if (c < 0x20 || c == '/' || c == '\\') return 0;
+    }
+    return 1;
+}
+
+static void preset_path(const moog_instance_t *inst, const char *name, char *path, size_t len) {
+    snprintf(path, len, "%s/presets/%s" PRESET_FILE_EXT, inst->cold.module_dir, name);
+}
+
+/* Makes a rename in dir durable */
+static void sync_dir(const char *dir) {
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+static int preset_write(const moog_instance_t *inst, const preset_job_t *job) {
+    char dir[512], tmp[600], path[600];
+    snprintf(dir, sizeof(dir), "%s/presets", inst->cold.module_dir);
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+    snprintf(tmp, sizeof(tmp), "%s/.%s" PRESET_FILE_EXT ".tmp", dir, job->name);
+    preset_path(inst, job->name, path, sizeof(path));
+
+    uint8_t data[PRESET_FILE_HEADER + PRESET_NAME_LEN + P_COUNT * 4];
+    memcpy(data, "RSPB", 4);
+    data[4] = PRESET_FILE_VERSION;
+    data[5] = P_COUNT;
+    data[6] = 1;
+    data[7] = 0;
+    memset(data + PRESET_FILE_HEADER, 0, PRESET_NAME_LEN);
+    memcpy(data + PRESET_FILE_HEADER, job->name, strlen(job->name));
+    for (int i = 0; i < P_COUNT; i++) {
+        put_f32le(data + PRESET_FILE_HEADER + PRESET_NAME_LEN + i * 4, job->params[i]);
+    }
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return -1;
+    int ok = fwrite(data, 1, sizeof(data), f) == sizeof(data) &&
+             fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    sync_dir(dir);
+    return 0;
+}
+
+/* Returns: 0 on success, -1 on failure (logged) */
+static int preset_job_run(const moog_instance_t *inst, const preset_job_t *job) {
+    char path[600], new_path[600];
+    preset_path(inst, job->name, path, sizeof(path));
+    int result = -1;
+
+    switch (job->op) {
+        case PRESET_JOB_SAVE:
+            result = preset_write(inst, job);
+            break;
+        case PRESET_JOB_RENAME:
+            /* link() fails if new_path exists, so another preset is never
+             * replaced, even by a concurrent writer */
+            preset_path(inst, job->new_name, new_path, sizeof(new_path));
+            result = link(path, new_path);
+            if (result != 0 && errno == EEXIST) {
+                plugin_log("RaffoSynth: a preset with that name already exists");
+                return -1;
+            }
+            if (result == 0 && unlink(path) != 0) {
+                unlink(new_path);
+                result = -1;
+            }
+            break;
+        case PRESET_JOB_DELETE:
+            result = unlink(path);
+            break;
+    }
+    if (result != 0) {
+        plugin_log("RaffoSynth: preset file operation failed");
+    } else if (job->op != PRESET_JOB_SAVE) {
+        char dir[512];
+        snprintf(dir, sizeof(dir), "%s/presets", inst->cold.module_dir);
+        sync_dir(dir);
+    }
+    return result != 0 ? -1 : 0;
+}
+
+static void preset_worker_drain(preset_worker_t *w) {
+    unsigned int tail = w->tail;
+    while (tail != __atomic_load_n(&w->head, __ATOMIC_ACQUIRE)) {
+        if (preset_job_run(w->inst, &w->jobs[tail & (PRESET_JOB_QUEUE_SIZE - 1)]) != 0) {
+            __atomic_store_n(&w->last_failed, tail, __ATOMIC_RELAXED);
+        }
+        tail++;
+        __atomic_store_n(&w->tail, tail, __ATOMIC_RELEASE);
+        __atomic_store_n(&w->inst->cold.library_stale, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void *preset_worker_main(void *arg) {
+    preset_worker_t *w = (preset_worker_t *)arg;
+    for (;;) {
+        while (sem_wait(&w->wake) != 0 && errno == EINTR) {}
+        preset_worker_drain(w);
+        if (__atomic_load_n(&w->quit, __ATOMIC_ACQUIRE)) {
+            /* Jobs queued before quit was set are visible now; run them too */
+            preset_worker_drain(w);
+            break;
+        }
+    }
+    return NULL;
+}
+
+static preset_worker_t *preset_worker_get(moog_instance_t *inst) {
+    if (inst->cold.worker) return inst->cold.worker;
+
+    preset_worker_t *w = (preset_worker_t *)calloc(1, sizeof(preset_worker_t));
+    if (!w) return NULL;
+    w->inst = inst;
+    w->last_failed = ~0u;
+    if (sem_init(&w->wake, 0, 0) != 0) {
+        free(w);
+        return NULL;
+    }
+    if (pthread_create(&w->thread, NULL, preset_worker_main, w) != 0) {
+        sem_destroy(&w->wake);
+        free(w);
+        plugin_log("RaffoSynth: could not start the preset writer");
+        return NULL;
+    }
+    inst->cold.worker = w;
+    return w;
+}
+
+/* Returns: 1 once the job at queue position job has run, setting failed */
+static int preset_job_done(moog_instance_t *inst, unsigned int job, int *failed) {
+    preset_worker_t *w = inst->cold.worker;
+    if (!w) return 0;
+    if ((int)(__atomic_load_n(&w->tail, __ATOMIC_ACQUIRE) - job) <= 0) return 0;
+    *failed = __atomic_load_n(&w->last_failed, __ATOMIC_RELAXED) == job;
+    return 1;
+}
+
+/* Finishes the queued jobs, then stops the worker */
+static void preset_worker_stop(moog_instance_t *inst) {
+    preset_worker_t *w = inst->cold.worker;
+    if (!w) return;
+    __atomic_store_n(&w->quit, 1, __ATOMIC_RELEASE);
+    sem_post(&w->wake);
+    pthread_join(w->thread, NULL);
+    sem_destroy(&w->wake);
+    free(w);
+    inst->cold.worker = NULL;
+}
+
+/* Returns: 0 if queued, -1 if the worker is unavailable or busy */
+static int queue_preset_job(moog_instance_t *inst, const preset_job_t *job) {
+    preset_worker_t *w = preset_worker_get(inst);
+    if (!w) return -1;
+
+    unsigned int head = w->head;
+    unsigned int tail = __atomic_load_n(&w->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= PRESET_JOB_QUEUE_SIZE) {
+        plugin_log("RaffoSynth: preset writer busy, request dropped");
+        return -1;
+    }
+
+    w->jobs[head & (PRESET_JOB_QUEUE_SIZE - 1)] = *job;
+    __atomic_store_n(&w->head, head + 1, __ATOMIC_RELEASE);
+    sem_post(&w->wake);
+    inst->cold.last_job = head;
+    return 0;
+}
+
+/* The current preset is a presets/ file, or a save or rename of it is
+ * still pending */
+static int current_is_user_file(moog_instance_t *inst) {
+    if (inst->cold.select_by_name) return 1;
+    preset_library_t *lib = library_get(inst);
+    return lib && inst->current_preset >= inst->cold.preset_count + lib->bank_count;
+}
+
+/* The current preset's file name once the queued jobs have run */
+static const char *current_file_name(const moog_instance_t *inst) {
+    return inst->cold.select_by_name ? inst->cold.pending_name : inst->cold.preset_name;
+}
+
+/* Saves the current values under name and selects the new preset once
+ * its file is written */
+static void save_preset(moog_instance_t *inst, const char *name) {
+    if (!preset_name_valid(name)) {
+        plugin_log("RaffoSynth: invalid preset name");
+        return;
+    }
+
+    preset_job_t job;
+    job.op = PRESET_JOB_SAVE;
+    snprintf(job.name, sizeof(job.name), "%s", name);
+    memcpy(job.params, inst->params, sizeof(job.params));
+    if (queue_preset_job(inst, &job) != 0) return;
+
+    snprintf(inst->cold.pending_name, sizeof(inst->cold.pending_name), "%s", name);
+    inst->cold.select_by_name = 1;
+}
+
+static void rename_preset(moog_instance_t *inst, const char *name) {
+    if (!preset_name_valid(name) || !current_is_user_file(inst)) {
+        plugin_log("RaffoSynth: cannot rename this preset");
+        return;
+    }
+
+    preset_job_t job;
+    job.op = PRESET_JOB_RENAME;
+    memcpy(job.name, current_file_name(inst), sizeof(job.name));
+    snprintf(job.new_name, sizeof(job.new_name), "%s", name);
+    if (queue_preset_job(inst, &job) != 0) return;
+
+    snprintf(inst->cold.pending_name, sizeof(inst->cold.pending_name), "%s", name);
+    inst->cold.select_by_name = 1;
+}
+
+/* Deletes the current preset's file; the preset that takes its index is
+ * selected once the worker is done */
+static void delete_preset(moog_instance_t *inst) {
+    if (!current_is_user_file(inst)) {
+        plugin_log("RaffoSynth: cannot delete this preset");
+        return;
+    }
+
+    preset_job_t job;
+    job.op = PRESET_JOB_DELETE;
+    memcpy(job.name, current_file_name(inst), sizeof(job.name));
+    if (queue_preset_job(inst, &job) == 0) inst->cold.select_by_name = 0;
+}
+
 /* =====================================================================
  * Plugin API v2
  * ===================================================================== */
@@ -522,20 +1677,27 @@ static void* v2_create_instance(const char *module_dir, const char *json_default
     moog_instance_t *inst = (moog_instance_t*)calloc(1, sizeof(moog_instance_t));
     if (!inst) return NULL;
 
-    strncpy(inst->module_dir, module_dir, sizeof(inst->module_dir) - 1);
+    strncpy(inst->cold.module_dir, module_dir, sizeof(inst->cold.module_dir) - 1);
     inst->output_gain = 0.35f;
+    inst->block_frames = MOVE_FRAMES_PER_BLOCK;
 
     /* Initialize engine */
     moog_engine_init(&inst->engine);
-
-    /* Load factory presets */
-    inst->preset_count = FACTORY_PRESET_COUNT;
-    for (int i = 0; i < FACTORY_PRESET_COUNT; i++) {
-        memcpy(&inst->presets[i], &g_factory_presets[i], sizeof(MoogPreset));
-    }
-
-    /* Apply first preset */
+    inst->settings[S_OSC_MODE] = (int)inst->engine.osc_mode;
+    inst->settings[S_CONTROL_RATE] = inst->engine.control_rate;
+    inst->settings[S_FILTER_MODE] = (int)inst->engine.filter_mode;
+    inst->settings[S_FILTER_OVERSAMPLE] = (int)inst->engine.filter_oversample;
+    inst->settings[S_MIDI_TIMING] = 0;
+    inst->settings[S_POLYPHONY] = inst->engine.voice_count;
+
+    /* Factory presets are shared, not copied */
+    inst->cold.presets = g_factory_presets;
+    inst->cold.preset_count = FACTORY_PRESET_COUNT;
+
+    /* Apply first preset; no render can run yet, so apply everything now */
     apply_preset(inst, 0);
+    inst->param_dirty = PARAM_DIRTY_ALL;
+    drain_param_queue(inst);
 
     plugin_log("RaffoSynth v2: Instance created");
     return inst;
@@ -544,15 +1706,13 @@ static void* v2_create_instance(const char *module_dir, const char *json_default
 static void v2_destroy_instance(void *instance) {
     moog_instance_t *inst = (moog_instance_t*)instance;
     if (!inst) return;
+    preset_worker_stop(inst);
+    library_release(inst);
     free(inst);
     plugin_log("RaffoSynth v2: Instance destroyed");
 }
 
-static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source) {
-    moog_instance_t *inst = (moog_instance_t*)instance;
-    if (!inst || len < 2) return;
-    (void)source;
-
+static void apply_midi(moog_instance_t *inst, const uint8_t *msg, int len) {
     uint8_t status = msg[0] & 0xF0;
     uint8_t data1 = msg[1];
     uint8_t data2 = (len > 2) ? msg[2] : 0;
@@ -591,95 +1751,157 @@ static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source)
     }
 }
 
-static void v2_set_param(void *instance, const char *key, const char *val) {
+static int64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Queue the event for the next block. With midi_timing on, its offset is
+ * the time since the current block started, so events keep their spacing
+ * at the cost of up to one block of constant latency. */
+static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source) {
     moog_instance_t *inst = (moog_instance_t*)instance;
-    if (!inst) return;
+    if (!inst || len < 2) return;
+    (void)source;
 
-    /* State restore from patch save */
-    if (strcmp(key, "state") == 0) {
-        float fval;
+    unsigned int head = inst->midi_head;
+    unsigned int tail = __atomic_load_n(&inst->midi_tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= MIDI_QUEUE_SIZE) {
+        /* Queue full: drop the event and stop all notes at the next block,
+         * so a lost note-off cannot leave a note stuck. The engine is only
+         * ever touched from render_block. */
+        mark_dirty(inst, PARAM_BIT(PQ_ALL_NOTES_OFF));
+        return;
+    }
 
-        if (json_get_number(val, "preset", &fval) == 0) {
-            int idx = (int)fval;
-            if (idx >= 0 && idx < inst->preset_count) {
-                apply_preset(inst, idx);
-            }
+    int offset = 0;
+    if (__atomic_load_n(&inst->settings[S_MIDI_TIMING], __ATOMIC_RELAXED)) {
+        int64_t start = __atomic_load_n(&inst->block_start_ns, __ATOMIC_RELAXED);
+        int64_t elapsed = monotonic_ns() - start;
+        if (start > 0 && elapsed > 0) {
+            int64_t frames = elapsed * MOVE_SAMPLE_RATE / 1000000000;
+            int last = __atomic_load_n(&inst->block_frames, __ATOMIC_RELAXED) - 1;
+            offset = (frames > last) ? last : (int)frames;
         }
+    }
 
-        if (json_get_number(val, "octave_transpose", &fval) == 0) {
-            inst->octave_transpose = (int)fval;
-            inst->engine.octave_transpose = inst->octave_transpose;
-        }
+    midi_event_t *ev = &inst->midi_queue[head & (MIDI_QUEUE_SIZE - 1)];
+    ev->offset = offset;
+    ev->len = (len > 3) ? 3 : len;
+    memcpy(ev->msg, msg, ev->len);
+    __atomic_store_n(&inst->midi_head, head + 1, __ATOMIC_RELEASE);
+}
 
-        /* Restore individual params */
-        for (int i = 0; i < (int)PARAM_DEF_COUNT(g_shadow_params); i++) {
-            if (json_get_number(val, g_shadow_params[i].key, &fval) == 0) {
-                if (fval < g_shadow_params[i].min_val) fval = g_shadow_params[i].min_val;
-                if (fval > g_shadow_params[i].max_val) fval = g_shadow_params[i].max_val;
-                inst->params[g_shadow_params[i].index] = fval;
-            }
-        }
-        apply_params_to_engine(inst);
+/* Store a clamped param value on the control side and queue it */
+static void set_param_value(moog_instance_t *inst, const param_def_t *def, float val) {
+    float fval = param_helper_clamp(def, val);
+    store_shared_param(inst, def->index, fval);
+    queue_param(inst, def->index, fval);
+}
+
+static void v2_set_param(void *instance, const char *key, const char *val) {
+    moog_instance_t *inst = (moog_instance_t*)instance;
+    if (!inst) return;
+
+    int k = param_keymap_find(&g_plugin_keys, key);
+
+    /* State restore from patch save */
+    if (k == K_STATE) {
+        restore_state(inst, val);
+        return;
+    }
+    if (k == K_STATE_BIN) {
+        restore_state_bin(inst, val);
         return;
     }
 
-    if (strcmp(key, "preset") == 0) {
-        int idx = atoi(val);
-        if (idx >= 0 && idx < inst->preset_count) {
-            apply_preset(inst, idx);
-        }
+    if (k == K_PRESET) {
+        inst->cold.select_by_name = 0;  /* An explicit choice wins over a pending save */
+        apply_preset(inst, atoi(val));
     }
-    else if (strcmp(key, "octave_transpose") == 0) {
-        inst->octave_transpose = atoi(val);
-        if (inst->octave_transpose < -3) inst->octave_transpose = -3;
-        if (inst->octave_transpose > 3) inst->octave_transpose = 3;
-        inst->engine.octave_transpose = inst->octave_transpose;
+    else if (k == K_SAVE_PRESET) {
+        save_preset(inst, val);
     }
-    else if (strcmp(key, "all_notes_off") == 0) {
-        moog_engine_all_notes_off(&inst->engine);
+    else if (k == K_RENAME_PRESET) {
+        rename_preset(inst, val);
+    }
+    else if (k == K_DELETE_PRESET) {
+        delete_preset(inst);
+    }
+    else if (k == K_OCTAVE_TRANSPOSE) {
+        int octave = atoi(val);
+        if (octave < -3) octave = -3;
+        if (octave > 3) octave = 3;
+        __atomic_store_n(&inst->octave_transpose, octave, __ATOMIC_RELAXED);
+        queue_param(inst, PQ_OCTAVE, (float)octave);
+    }
+    else if (k == K_ALL_NOTES_OFF) {
+        queue_param(inst, PQ_ALL_NOTES_OFF, 0.0f);
+    }
+    else if (k >= K_SETTING) {
+        set_engine_setting(inst, k - K_SETTING, atoi(val));
     }
     else {
-        /* Named parameter access */
-        for (int i = 0; i < (int)PARAM_DEF_COUNT(g_shadow_params); i++) {
-            if (strcmp(key, g_shadow_params[i].key) == 0) {
-                float fval = (float)atof(val);
-                if (fval < g_shadow_params[i].min_val) fval = g_shadow_params[i].min_val;
-                if (fval > g_shadow_params[i].max_val) fval = g_shadow_params[i].max_val;
-                inst->params[g_shadow_params[i].index] = fval;
-                apply_params_to_engine(inst);
-                return;
-            }
-        }
+        /* Named (or numbered) parameter access */
+        const param_def_t *def = find_param(key);
+        if (def) set_param_value(inst, def, (float)atof(val));
     }
 }
 
+/* Set a parameter by its numeric id (the P_* index, listed as "id" in
+ * chain_params) without formatting a string or looking up a key. Hosts
+ * that automate many params can look this symbol up next to
+ * move_plugin_init_v2. Returns: 0 on success, -1 if the id is unknown */
+extern "C" int move_plugin_set_param_by_id_v2(void *instance, int id, float val) {
+    moog_instance_t *inst = (moog_instance_t*)instance;
+    if (!inst) return -1;
+
+    const param_def_t *def = param_index_find_id(&g_param_index, id);
+    if (!def) return -1;
+    set_param_value(inst, def, val);
+    return 0;
+}
+
 static int v2_get_param(void *instance, const char *key, char *buf, int buf_len) {
     moog_instance_t *inst = (moog_instance_t*)instance;
     if (!inst) return -1;
 
-    if (strcmp(key, "preset") == 0) {
+    int k = param_keymap_find(&g_plugin_keys, key);
+
+    if (k == K_PRESET) {
+        if (inst->cold.worker) library_get(inst);  /* Follow saved files */
         return snprintf(buf, buf_len, "%d", inst->current_preset);
     }
-    if (strcmp(key, "preset_count") == 0) {
-        return snprintf(buf, buf_len, "%d", inst->preset_count);
+    if (k == K_PRESET_COUNT) {
+        return snprintf(buf, buf_len, "%d", preset_total(inst));
     }
-    if (strcmp(key, "preset_name") == 0) {
-        return snprintf(buf, buf_len, "%s", inst->preset_name);
+    if (k == K_PRESET_NAME) {
+        return snprintf(buf, buf_len, "%s", inst->cold.preset_name);
     }
-    if (strcmp(key, "name") == 0) {
+    if (k == K_NAME) {
         return snprintf(buf, buf_len, "RaffoSynth");
     }
-    if (strcmp(key, "octave_transpose") == 0) {
+    if (k == K_OCTAVE_TRANSPOSE) {
         return snprintf(buf, buf_len, "%d", inst->octave_transpose);
     }
+    /* Last block was idle silence; the host may skip mixing this slot */
+    if (k == K_IS_SILENT) {
+        return snprintf(buf, buf_len, "%d", __atomic_load_n(&inst->engine.silent, __ATOMIC_RELAXED));
+    }
+    if (k >= K_SETTING) {
+        return snprintf(buf, buf_len, "%d", inst->settings[k - K_SETTING]);
+    }
 
-    /* Named parameter access via helper */
-    int result = param_helper_get(g_shadow_params, PARAM_DEF_COUNT(g_shadow_params),
-                                  inst->params, key, buf, buf_len);
-    if (result >= 0) return result;
+    /* Named (or numbered) parameter access */
+    if (k < 0) {
+        const param_def_t *def = find_param(key);
+        if (def) return param_helper_format(def, inst->params, buf, buf_len);
+        return -1;
+    }
 
     /* UI hierarchy for shadow parameter editor */
-    if (strcmp(key, "ui_hierarchy") == 0) {
+    if (k == K_UI_HIERARCHY) {
         const char *hierarchy = "{"
             "\"modes\":null,"
             "\"levels\":{"
@@ -755,7 +1977,7 @@ static int v2_get_param(void *instance, const char *key, char *buf, int buf_len)
                 "\"performance\":{"
                     "\"children\":null,"
                     "\"knobs\":[\"glide\",\"mod_filter\",\"mod_pitch\",\"bend_range\",\"vel_sens\",\"octave_transpose\"],"
-                    "\"params\":[\"glide\",\"mod_filter\",\"mod_pitch\",\"bend_range\",\"vel_sens\",\"octave_transpose\"]"
+                    "\"params\":[\"glide\",\"mod_filter\",\"mod_pitch\",\"bend_range\",\"vel_sens\",\"octave_transpose\",\"osc_mode\",\"control_rate\",\"filter_mode\",\"filter_oversample\",\"midi_timing\",\"polyphony\"]"
                 "}"
             "}"
         "}";
@@ -768,12 +1990,17 @@ static int v2_get_param(void *instance, const char *key, char *buf, int buf_len)
     }
 
     /* State serialization for patch save/load */
-    if (strcmp(key, "state") == 0) {
+    if (k == K_STATE) {
         int offset = 0;
         offset += snprintf(buf + offset, buf_len - offset,
             "{\"preset\":%d,\"octave_transpose\":%d",
             inst->current_preset, inst->octave_transpose);
 
+        for (int i = 0; i < S_COUNT; i++) {
+            offset += snprintf(buf + offset, buf_len - offset,
+                ",\"%s\":%d", g_engine_settings[i].key, inst->settings[i]);
+        }
+
         for (int i = 0; i < (int)PARAM_DEF_COUNT(g_shadow_params); i++) {
             float val = inst->params[g_shadow_params[i].index];
             offset += snprintf(buf + offset, buf_len - offset,
@@ -784,17 +2011,32 @@ static int v2_get_param(void *instance, const char *key, char *buf, int buf_len)
         return offset;
     }
 
+    /* Compact state for fast patch switching (see Binary state) */
+    if (k == K_STATE_BIN) {
+        uint8_t bin[STATE_BIN_MAX];
+        int len = state_bin_write(inst, bin);
+        return base64_encode(bin, len, buf, buf_len);
+    }
+
     /* Chain params metadata */
-    if (strcmp(key, "chain_params") == 0) {
+    if (k == K_CHAIN_PARAMS) {
         int offset = 0;
         offset += snprintf(buf + offset, buf_len - offset,
             "[{\"key\":\"preset\",\"name\":\"Preset\",\"type\":\"int\",\"min\":0,\"max\":9999},"
             "{\"key\":\"octave_transpose\",\"name\":\"Octave\",\"type\":\"int\",\"min\":-3,\"max\":3}");
 
+        for (int i = 0; i < S_COUNT; i++) {
+            offset += snprintf(buf + offset, buf_len - offset,
+                ",{\"key\":\"%s\",\"name\":\"%s\",\"type\":\"int\",\"min\":%d,\"max\":%d}",
+                g_engine_settings[i].key, g_engine_settings[i].name,
+                g_engine_settings[i].min_val, g_engine_settings[i].max_val);
+        }
+
         for (int i = 0; i < (int)PARAM_DEF_COUNT(g_shadow_params) && offset < buf_len - 100; i++) {
             offset += snprintf(buf + offset, buf_len - offset,
-                ",{\"key\":\"%s\",\"name\":\"%s\",\"type\":\"%s\",\"min\":%g,\"max\":%g}",
+                ",{\"key\":\"%s\",\"id\":%d,\"name\":\"%s\",\"type\":\"%s\",\"min\":%g,\"max\":%g}",
                 g_shadow_params[i].key,
+                g_shadow_params[i].index,
                 g_shadow_params[i].name[0] ? g_shadow_params[i].name : g_shadow_params[i].key,
                 g_shadow_params[i].type == PARAM_TYPE_INT ? "int" : "float",
                 g_shadow_params[i].min_val,
@@ -807,20 +2049,15 @@ static int v2_get_param(void *instance, const char *key, char *buf, int buf_len)
     return -1;
 }
 
-static void v2_render_block(void *instance, int16_t *out_interleaved_lr, int frames) {
-    moog_instance_t *inst = (moog_instance_t*)instance;
-    if (!inst) {
+/* Stereo int16 from the mono render, with soft clipping */
+static void write_output(const moog_instance_t *inst, const float *mono_buf, int silent,
+                         int16_t *out_interleaved_lr, int frames) {
+    /* Idle: nothing to convert */
+    if (silent) {
         memset(out_interleaved_lr, 0, frames * 4);
         return;
     }
 
-    /* Render mono audio */
-    float mono_buf[256];
-    if (frames > 256) frames = 256;
-
-    moog_engine_render(&inst->engine, mono_buf, frames);
-
-    /* Convert to stereo int16 with soft clipping */
     float gain = inst->output_gain;
     for (int i = 0; i < frames; i++) {
         float sample = mono_buf[i] * gain;
@@ -839,6 +2076,117 @@ static void v2_render_block(void *instance, int16_t *out_interleaved_lr, int fra
     }
 }
 
+/* Instances rendered together by move_plugin_render_batch_v2 */
+#define RENDER_BATCH_MAX 16
+
+/* Batch working memory, created at plugin load; batches are rendered from
+ * the host's audio thread only */
+static moog_batch_scratch_t *g_batch_scratch = NULL;
+
+/* Render one block of up to RENDER_BATCH_MAX instances. Queued MIDI plays
+ * at its offsets: the render is split at every event offset of any
+ * instance, so all engines advance over the same segments. */
+static void render_instances(moog_instance_t *const *insts, int16_t *const *outs,
+                             int count, int frames) {
+    moog_engine_t *engines[RENDER_BATCH_MAX];
+    float *bufs[RENDER_BATCH_MAX];
+    unsigned int tail[RENDER_BATCH_MAX];
+    unsigned int head[RENDER_BATCH_MAX];
+    int silent[RENDER_BATCH_MAX];
+
+    int64_t now_ns = monotonic_ns();
+    for (int k = 0; k < count; k++) {
+        moog_instance_t *inst = insts[k];
+        __atomic_store_n(&inst->block_start_ns, now_ns, __ATOMIC_RELAXED);
+        __atomic_store_n(&inst->block_frames, frames, __ATOMIC_RELAXED);
+
+        /* A pending all-notes-off (set on MIDI overflow) also discards the
+         * events queued before it, whose note-offs may have been dropped */
+        if (__atomic_load_n(&inst->param_dirty, __ATOMIC_ACQUIRE) & PARAM_BIT(PQ_ALL_NOTES_OFF)) {
+            __atomic_store_n(&inst->midi_tail, __atomic_load_n(&inst->midi_head, __ATOMIC_ACQUIRE),
+                             __ATOMIC_RELEASE);
+        }
+
+        /* Parameter changes land at the block start, ahead of any MIDI */
+        drain_param_queue(inst);
+
+        engines[k] = &inst->engine;
+        tail[k] = inst->midi_tail;
+        head[k] = __atomic_load_n(&inst->midi_head, __ATOMIC_ACQUIRE);
+        silent[k] = 1;
+    }
+
+    int pos = 0;
+    while (pos < frames) {
+        /* Apply events due by pos; the next event ends the segment */
+        int next = frames;
+        for (int k = 0; k < count; k++) {
+            for (; tail[k] != head[k]; tail[k]++) {
+                const midi_event_t *ev = &insts[k]->midi_queue[tail[k] & (MIDI_QUEUE_SIZE - 1)];
+                int offset = (ev->offset < frames) ? ev->offset : frames - 1;
+                if (offset > pos) {
+                    if (offset < next) next = offset;
+                    break;
+                }
+                apply_midi(insts[k], ev->msg, ev->len);
+            }
+        }
+
+        for (int k = 0; k < count; k++) bufs[k] = insts[k]->mono_buf + pos;
+        if (count > 1 && g_batch_scratch) {
+            moog_engine_render_batch(g_batch_scratch, engines, bufs, count, next - pos);
+        } else {
+            for (int k = 0; k < count; k++) moog_engine_render(engines[k], bufs[k], next - pos);
+        }
+        for (int k = 0; k < count; k++) silent[k] &= engines[k]->silent;
+        pos = next;
+    }
+
+    for (int k = 0; k < count; k++) {
+        __atomic_store_n(&insts[k]->midi_tail, tail[k], __ATOMIC_RELEASE);
+        write_output(insts[k], insts[k]->mono_buf, silent[k], outs[k], frames);
+    }
+}
+
+static void v2_render_block(void *instance, int16_t *out_interleaved_lr, int frames) {
+    moog_instance_t *inst = (moog_instance_t*)instance;
+    if (!inst) {
+        memset(out_interleaved_lr, 0, frames * 4);
+        return;
+    }
+    if (frames > 256) frames = 256;
+
+    render_instances(&inst, &out_interleaved_lr, 1, frames);
+}
+
+/* Render one block for several instances of this plugin at once; same
+ * output as calling render_block on each. Hosts running several
+ * RaffoSynth slots can look this symbol up and call it instead, so the
+ * engines share vector passes (see moog_engine_render_batch). Batches
+ * share one working area, so call it from one thread at a time. */
+extern "C" void move_plugin_render_batch_v2(void *const *instances, int16_t *const *outs,
+                                            int count, int frames) {
+    if (frames > 256) frames = 256;
+
+    moog_instance_t *insts[RENDER_BATCH_MAX];
+    int16_t *inst_outs[RENDER_BATCH_MAX];
+    int n = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (!instances[i]) {
+            memset(outs[i], 0, frames * 4);
+            continue;
+        }
+        insts[n] = (moog_instance_t*)instances[i];
+        inst_outs[n] = outs[i];
+        if (++n == RENDER_BATCH_MAX) {
+            render_instances(insts, inst_outs, n, frames);
+            n = 0;
+        }
+    }
+    if (n > 0) render_instances(insts, inst_outs, n, frames);
+}
+
 static int v2_get_error(void *instance, char *buf, int buf_len) {
     (void)instance;
     (void)buf;
@@ -852,6 +2200,11 @@ static plugin_api_v2_t g_plugin_api_v2;
 extern "C" plugin_api_v2_t* move_plugin_init_v2(const host_api_v1_t *host) {
     g_host = host;
 
+    /* Shared wavetables and key maps, built once for all instances */
+    moog_engine_tables_init();
+    build_key_maps();
+    if (!g_batch_scratch) g_batch_scratch = moog_engine_batch_scratch_create();
+
     memset(&g_plugin_api_v2, 0, sizeof(g_plugin_api_v2));
     g_plugin_api_v2.api_version = MOVE_PLUGIN_API_VERSION_2;
     g_plugin_api_v2.create_instance = v2_create_instance;
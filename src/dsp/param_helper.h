@@ -8,6 +8,12 @@
  *   1. Define your params: static const param_def_t my_params[] = { ... };
  *   2. In get_param: return param_helper_get(my_params, COUNT, values, key, buf, len);
  *   3. In set_param: return param_helper_set(my_params, COUNT, values, key, val);
+ *
+ * For hosts that poll or automate many keys, build a param_index_t once at
+ * plugin init and use param_index_find() / param_index_find_id() instead:
+ * lookups cost one hash and usually one strcmp rather than a table scan.
+ * Hosts that address params by integer id can skip strings altogether
+ * through param_index_set_id().
  */
 
 #ifndef PARAM_HELPER_H
@@ -16,6 +22,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 /* Parameter types */
 typedef enum {
@@ -33,6 +40,25 @@ typedef struct {
     float max_val;        /* Maximum value */
 } param_def_t;
 
+/*
+ * Format a parameter value.
+ * Returns: length written to buf
+ */
+static inline int param_helper_format(const param_def_t *def, const float *values,
+                                      char *buf, int buf_len) {
+    if (def->type == PARAM_TYPE_INT) {
+        return snprintf(buf, buf_len, "%d", (int)values[def->index]);
+    }
+    return snprintf(buf, buf_len, "%.3f", values[def->index]);
+}
+
+/* Clamp a value to a parameter's range */
+static inline float param_helper_clamp(const param_def_t *def, float v) {
+    if (v < def->min_val) v = def->min_val;
+    if (v > def->max_val) v = def->max_val;
+    return v;
+}
+
 /*
  * Get a parameter value by key.
  * Returns: length written to buf, or -1 if key not found
@@ -47,11 +73,7 @@ static inline int param_helper_get(
 ) {
     for (int i = 0; i < def_count; i++) {
         if (strcmp(key, defs[i].key) == 0) {
-            if (defs[i].type == PARAM_TYPE_INT) {
-                return snprintf(buf, buf_len, "%d", (int)values[defs[i].index]);
-            } else {
-                return snprintf(buf, buf_len, "%.3f", values[defs[i].index]);
-            }
+            return param_helper_format(&defs[i], values, buf, buf_len);
         }
     }
     return -1;  /* Key not found */
@@ -70,11 +92,7 @@ static inline int param_helper_set(
 ) {
     for (int i = 0; i < def_count; i++) {
         if (strcmp(key, defs[i].key) == 0) {
-            float v = (float)atof(val);
-            /* Clamp to min/max */
-            if (v < defs[i].min_val) v = defs[i].min_val;
-            if (v > defs[i].max_val) v = defs[i].max_val;
-            values[defs[i].index] = v;
+            values[defs[i].index] = param_helper_clamp(&defs[i], (float)atof(val));
             return 0;
         }
     }
@@ -111,6 +129,115 @@ static inline int param_helper_chain_params_json(
     return offset;
 }
 
+/*
+ * Hashed key map: string keys to small integers (FNV-1a, linear probing).
+ * Keys are not copied, so they must outlive the map (string literals or
+ * static tables). Keep it under half full for short probe runs.
+ */
+#define PARAM_KEYMAP_SIZE 128  /* Power of two */
+
+typedef struct {
+    const char *key[PARAM_KEYMAP_SIZE];
+    uint32_t hash[PARAM_KEYMAP_SIZE];
+    int value[PARAM_KEYMAP_SIZE];
+    int count;
+} param_keymap_t;
+
+static inline uint32_t param_hash(const char *key) {
+    uint32_t h = 2166136261u;
+    while (*key) {
+        h ^= (uint8_t)*key++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/*
+ * Add a key. Returns: 0 on success, -1 if the map is half full or the key
+ * is already present.
+ */
+static inline int param_keymap_add(param_keymap_t *map, const char *key, int value) {
+    if (map->count >= PARAM_KEYMAP_SIZE / 2) return -1;
+
+    uint32_t h = param_hash(key);
+    for (uint32_t i = h;; i++) {
+        uint32_t slot = i & (PARAM_KEYMAP_SIZE - 1);
+        if (!map->key[slot]) {
+            map->key[slot] = key;
+            map->hash[slot] = h;
+            map->value[slot] = value;
+            map->count++;
+            return 0;
+        }
+        if (map->hash[slot] == h && strcmp(map->key[slot], key) == 0) return -1;
+    }
+}
+
+/*
+ * Look a key up.
+ * Returns: its value, or -1 if not found
+ */
+static inline int param_keymap_find(const param_keymap_t *map, const char *key) {
+    uint32_t h = param_hash(key);
+    for (uint32_t i = h;; i++) {
+        uint32_t slot = i & (PARAM_KEYMAP_SIZE - 1);
+        if (!map->key[slot]) return -1;
+        if (map->hash[slot] == h && strcmp(map->key[slot], key) == 0) return map->value[slot];
+    }
+}
+
+/*
+ * Index over a parameter table: by key, or by integer id (the def's index
+ * into the values array) for hosts that address params numerically.
+ */
+#define PARAM_INDEX_MAX_ID 128
+
+typedef struct {
+    const param_def_t *defs;
+    param_keymap_t keys;                  /* Key -> position in defs */
+    int16_t by_id[PARAM_INDEX_MAX_ID];    /* Values index -> position in defs, -1 if none */
+} param_index_t;
+
+/*
+ * Build the index. Returns: 0 on success, -1 on a duplicate key, an id out
+ * of range or too many params.
+ */
+static inline int param_index_build(param_index_t *idx, const param_def_t *defs, int def_count) {
+    memset(idx, 0, sizeof(*idx));
+    memset(idx->by_id, 0xFF, sizeof(idx->by_id));
+    idx->defs = defs;
+
+    for (int i = 0; i < def_count; i++) {
+        if (defs[i].index < 0 || defs[i].index >= PARAM_INDEX_MAX_ID) return -1;
+        if (param_keymap_add(&idx->keys, defs[i].key, i) != 0) return -1;
+        idx->by_id[defs[i].index] = (int16_t)i;
+    }
+    return 0;
+}
+
+/* Returns: the definition for key, or NULL if not found */
+static inline const param_def_t *param_index_find(const param_index_t *idx, const char *key) {
+    int i = param_keymap_find(&idx->keys, key);
+    return (i >= 0) ? &idx->defs[i] : NULL;
+}
+
+/* Returns: the definition for a values index, or NULL if not found */
+static inline const param_def_t *param_index_find_id(const param_index_t *idx, int id) {
+    if (id < 0 || id >= PARAM_INDEX_MAX_ID || idx->by_id[id] < 0) return NULL;
+    return &idx->defs[idx->by_id[id]];
+}
+
+/*
+ * Set a parameter value by integer id, clamped to its range.
+ * Returns: 0 on success, -1 if id not found
+ */
+static inline int param_index_set_id(const param_index_t *idx, float *values, int id, float val) {
+    const param_def_t *def = param_index_find_id(idx, id);
+    if (!def) return -1;
+    values[def->index] = param_helper_clamp(def, val);
+    return 0;
+}
+
 /* Convenience macro for array count */
 #define PARAM_DEF_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
 
@@ -0,0 +1,1036 @@
+/*
+ * moog_render - Offline renderer and benchmark for RaffoSynth
+ *
+ * Native command-line build of the DSP plugin for exercising the engine
+ * off-device. The plugin is driven through its V2 API exactly as the
+ * Move host drives it: factory presets are selected with the "preset"
+ * param, the note script goes through on_midi into
+ * moog_engine_note_on/off, and audio comes from render_block, which
+ * calls moog_engine_render.
+ *
+ * Usage: moog_render [options]
+ *   -p, --preset N      Render only factory preset N (default: all)
+ *   -s, --script FILE   Note script (default: built-in script)
+ *   -o, --out DIR       Write DIR/NN_Name.wav per preset
+ *   -r, --repeat N      Timed passes per preset, best is reported (default 3)
+ *   -b, --block N       Frames per render_block call (default 128)
+ *   --set KEY=VAL       Set a param after loading the preset (repeatable)
+ *   --tail SEC          Tail benchmark: hold one note for SEC/2 seconds with
+ *                       sustain at zero, then a long release, so decaying
+ *                       state runs toward denormal range
+ *   --voices N          Polyphony benchmark: N voices hold an N-note chord
+ *                       for 2 seconds, then release; adds the cost per voice
+ *   --batch N           Run N instances through move_plugin_render_batch_v2;
+ *                       timing is per instance, output is the first one's
+ *
+ * Timing reports the best pass average and the slowest 100 ms window of
+ * that run, which exposes CPU spikes such as denormal slowdowns.
+ *
+ * Golden output regression:
+ *   --golden-write DIR  Record reference renders into DIR
+ *   --golden-check DIR  Compare renders against DIR, exit 1 on mismatch
+ *   --snr DB            Accept time-domain SNR >= DB instead of bit-exact
+ *   --spectral DB       Accept band spectrum deviation <= DB instead of
+ *                       bit-exact (for changes that shift phase)
+ *
+ * Filter coefficient table check:
+ *   --filter-check      Sweep cutoff and resonance at each oversampling
+ *                       rate and compare the interpolated table with the
+ *                       exact computation; exit 1 past the tolerances
+ *
+ * Note script: one event per line, "<time_ms> <event> [args]"
+ *   0     on 48 100     Note on (note, velocity)
+ *   500   off 48        Note off
+ *   600   bend 0.5      Pitch bend (-1.0 - 1.0)
+ *   700   cc 1 127      Control change
+ *   4000  end           Stop rendering
+ * Blank lines and lines starting with '#' are ignored. Events are applied
+ * at the first block boundary at or after their time (midi_timing is 0
+ * unless set otherwise, as offline renders have no real-time clock).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+extern "C" {
+#include <stdint.h>
+
+/* Mirrors the host API declared in moog_plugin.cpp */
+typedef struct host_api_v1 {
+    uint32_t api_version;
+    int sample_rate;
+    int frames_per_block;
+    uint8_t *mapped_memory;
+    int audio_out_offset;
+    int audio_in_offset;
+    void (*log)(const char *msg);
+    int (*midi_send_internal)(const uint8_t *msg, int len);
+    int (*midi_send_external)(const uint8_t *msg, int len);
+} host_api_v1_t;
+
+typedef struct plugin_api_v2 {
+    uint32_t api_version;
+    void* (*create_instance)(const char *module_dir, const char *json_defaults);
+    void (*destroy_instance)(void *instance);
+    void (*on_midi)(void *instance, const uint8_t *msg, int len, int source);
+    void (*set_param)(void *instance, const char *key, const char *val);
+    int (*get_param)(void *instance, const char *key, char *buf, int buf_len);
+    int (*get_error)(void *instance, char *buf, int buf_len);
+    void (*render_block)(void *instance, int16_t *out_interleaved_lr, int frames);
+} plugin_api_v2_t;
+
+plugin_api_v2_t* move_plugin_init_v2(const host_api_v1_t *host);
+void move_plugin_render_batch_v2(void *const *instances, int16_t *const *outs,
+                                 int count, int frames);
+}
+
+#include "moog_engine.h"
+
+#define SAMPLE_RATE 44100
+#define MAX_BLOCK 256
+#define MAX_SETTINGS 32
+#define MAX_BATCH 16
+#define WINDOW_FRAMES (SAMPLE_RATE / 10)
+
+/* =====================================================================
+ * Note script
+ * ===================================================================== */
+
+typedef enum {
+    EV_NOTE_ON = 0,
+    EV_NOTE_OFF,
+    EV_BEND,
+    EV_CC,
+    EV_END
+} event_type_t;
+
+typedef struct {
+    int frame;          /* Time in samples */
+    event_type_t type;
+    int a;              /* Note or controller number */
+    int b;              /* Velocity, controller value or 14-bit bend */
+} script_event_t;
+
+typedef struct {
+    script_event_t *events;
+    int count;
+    int capacity;
+    int length;         /* Total frames to render */
+} note_script_t;
+
+/* Built-in script: notes across the keyboard with overlapping legato,
+ * a bend and a mod wheel sweep, then a release tail */
+static const char *g_default_script =
+    "0    on 36 100\n"
+    "400  off 36\n"
+    "500  on 48 80\n"
+    "900  on 55 110\n"
+    "1000 off 48\n"
+    "1300 off 55\n"
+    "1500 on 60 127\n"
+    "1800 bend 1.0\n"
+    "2100 bend 0.0\n"
+    "2300 off 60\n"
+    "2500 on 72 90\n"
+    "2600 cc 1 127\n"
+    "3300 cc 1 0\n"
+    "3400 off 72\n"
+    "3500 on 84 60\n"
+    "3900 off 84\n"
+    "4000 on 43 100\n"
+    "4800 off 43\n"
+    "6000 end\n";
+
+static int script_add(note_script_t *s, const script_event_t *ev) {
+    if (s->count == s->capacity) {
+        int cap = s->capacity ? s->capacity * 2 : 64;
+        script_event_t *events = (script_event_t*)realloc(s->events, cap * sizeof(script_event_t));
+        if (!events) return -1;
+        s->events = events;
+        s->capacity = cap;
+    }
+    s->events[s->count++] = *ev;
+    return 0;
+}
+
+/* Parse script text. Events must be in time order. Returns 0 on success. */
+static int script_parse(note_script_t *s, const char *text) {
+    memset(s, 0, sizeof(*s));
+    int line_no = 0;
+
+    while (*text) {
+        const char *eol = strchr(text, '\n');
+        int len = eol ? (int)(eol - text) : (int)strlen(text);
+        char line[256];
+        if (len > (int)sizeof(line) - 1) len = sizeof(line) - 1;
+        memcpy(line, text, len);
+        line[len] = '\0';
+        text = eol ? eol + 1 : text + strlen(text);
+        line_no++;
+
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0' || *p == '#' || *p == '\r') continue;
+
+        double ms;
+        char name[16];
+        double a = 0, b = 0;
+        int n = sscanf(p, "%lf %15s %lf %lf", &ms, name, &a, &b);
+        if (n < 2) {
+            fprintf(stderr, "script line %d: expected \"<time_ms> <event>\"\n", line_no);
+            return -1;
+        }
+
+        script_event_t ev;
+        ev.frame = (int)(ms * SAMPLE_RATE / 1000.0 + 0.5);
+        ev.a = (int)a;
+        ev.b = (int)b;
+
+        if (strcmp(name, "on") == 0 && n == 4) {
+            ev.type = EV_NOTE_ON;
+        } else if (strcmp(name, "off") == 0 && n >= 3) {
+            ev.type = EV_NOTE_OFF;
+        } else if (strcmp(name, "bend") == 0 && n >= 3) {
+            ev.type = EV_BEND;
+            int bend = (int)((a + 1.0) * 8192.0);
+            if (bend < 0) bend = 0;
+            if (bend > 16383) bend = 16383;
+            ev.b = bend;
+        } else if (strcmp(name, "cc") == 0 && n == 4) {
+            ev.type = EV_CC;
+        } else if (strcmp(name, "end") == 0) {
+            ev.type = EV_END;
+        } else {
+            fprintf(stderr, "script line %d: bad event \"%s\"\n", line_no, name);
+            return -1;
+        }
+
+        if (s->count > 0 && ev.frame < s->events[s->count - 1].frame) {
+            fprintf(stderr, "script line %d: events out of order\n", line_no);
+            return -1;
+        }
+        if (script_add(s, &ev) != 0) return -1;
+        if (ev.type == EV_END) break;
+    }
+
+    if (s->count == 0) {
+        fprintf(stderr, "script has no events\n");
+        return -1;
+    }
+
+    /* Without an explicit end, leave two seconds for the release */
+    const script_event_t *last = &s->events[s->count - 1];
+    s->length = (last->type == EV_END) ? last->frame : last->frame + 2 * SAMPLE_RATE;
+    return 0;
+}
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = (char*)malloc(size + 1);
+    if (buf && fread(buf, 1, size, f) != (size_t)size) {
+        free(buf);
+        buf = NULL;
+    }
+    if (buf) buf[size] = '\0';
+    fclose(f);
+    return buf;
+}
+
+static void send_event(const plugin_api_v2_t *api, void *inst, const script_event_t *ev) {
+    uint8_t msg[3];
+    switch (ev->type) {
+        case EV_NOTE_ON:
+            msg[0] = 0x90; msg[1] = (uint8_t)ev->a; msg[2] = (uint8_t)ev->b;
+            break;
+        case EV_NOTE_OFF:
+            msg[0] = 0x80; msg[1] = (uint8_t)ev->a; msg[2] = 0;
+            break;
+        case EV_BEND:
+            msg[0] = 0xE0; msg[1] = (uint8_t)(ev->b & 0x7F); msg[2] = (uint8_t)(ev->b >> 7);
+            break;
+        case EV_CC:
+            msg[0] = 0xB0; msg[1] = (uint8_t)ev->a; msg[2] = (uint8_t)ev->b;
+            break;
+        default:
+            return;
+    }
+    api->on_midi(inst, msg, 3, 0);
+}
+
+/* =====================================================================
+ * WAV output
+ * ===================================================================== */
+
+static void put_le(FILE *f, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) fputc((v >> (8 * i)) & 0xFF, f);
+}
+
+/* 16-bit stereo PCM */
+static int write_wav(const char *path, const int16_t *samples, int frames) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+
+    uint32_t data_bytes = (uint32_t)frames * 4;
+    fwrite("RIFF", 1, 4, f);
+    put_le(f, 36 + data_bytes, 4);
+    fwrite("WAVEfmt ", 1, 8, f);
+    put_le(f, 16, 4);
+    put_le(f, 1, 2);                    /* PCM */
+    put_le(f, 2, 2);                    /* Channels */
+    put_le(f, SAMPLE_RATE, 4);
+    put_le(f, SAMPLE_RATE * 4, 4);      /* Byte rate */
+    put_le(f, 4, 2);                    /* Block align */
+    put_le(f, 16, 2);                   /* Bits per sample */
+    fwrite("data", 1, 4, f);
+    put_le(f, data_bytes, 4);
+    for (int i = 0; i < frames * 2; i++) put_le(f, (uint16_t)samples[i], 2);
+
+    int err = ferror(f);
+    fclose(f);
+    return err ? -1 : 0;
+}
+
+/* =====================================================================
+ * Rendering
+ * ===================================================================== */
+
+typedef struct {
+    const char *settings[MAX_SETTINGS];   /* "key=val" overrides */
+    int setting_count;
+    int block;
+    int batch;                            /* Instances per batch render, 0 = render_block */
+} render_opts_t;
+
+typedef struct {
+    char name[64];
+    double ns_per_sample;   /* Best pass */
+    double worst_ns;        /* Slowest window, best pass */
+    double rms;             /* dBFS */
+    double peak;            /* dBFS */
+} render_result_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void apply_settings(const plugin_api_v2_t *api, void *inst, const render_opts_t *opts) {
+    for (int i = 0; i < opts->setting_count; i++) {
+        char key[64];
+        const char *eq = strchr(opts->settings[i], '=');
+        int len = (int)(eq - opts->settings[i]);
+        if (len > (int)sizeof(key) - 1) len = sizeof(key) - 1;
+        memcpy(key, opts->settings[i], len);
+        key[len] = '\0';
+        api->set_param(inst, key, eq + 1);
+    }
+}
+
+/* One pass of the script through a fresh instance (or opts->batch fresh
+ * instances rendered together). Only the MIDI and render calls are timed.
+ * Returns elapsed seconds per instance and stores the slowest
+ * WINDOW_FRAMES window in worst_ns. */
+static double render_pass(const plugin_api_v2_t *api, int preset, const note_script_t *script,
+                          const render_opts_t *opts, int16_t *out, char *name, int name_len,
+                          double *worst_ns) {
+    void *insts[MAX_BATCH];
+    int16_t *outs[MAX_BATCH];
+    static int16_t batch_out[MAX_BATCH - 1][MAX_BLOCK * 2];
+    int count = (opts->batch > 0) ? opts->batch : 1;
+
+    for (int k = 0; k < count; k++) {
+        insts[k] = api->create_instance(".", "");
+        if (!insts[k]) {
+            while (k-- > 0) api->destroy_instance(insts[k]);
+            return -1.0;
+        }
+
+        char val[16];
+        snprintf(val, sizeof(val), "%d", preset);
+        api->set_param(insts[k], "preset", val);
+        /* Offline there is no real-time clock to timestamp MIDI against */
+        api->set_param(insts[k], "midi_timing", "0");
+        apply_settings(api, insts[k], opts);
+    }
+    if (name) api->get_param(insts[0], "preset_name", name, name_len);
+
+    int next = 0;
+    double elapsed = 0.0;
+    double t0 = now_seconds();
+    double window_start = t0;
+    int window_frames = 0;
+    *worst_ns = 0.0;
+
+    for (int pos = 0; pos < script->length; pos += opts->block) {
+        int frames = script->length - pos;
+        if (frames > opts->block) frames = opts->block;
+
+        while (next < script->count && script->events[next].frame <= pos) {
+            for (int k = 0; k < count; k++) send_event(api, insts[k], &script->events[next]);
+            next++;
+        }
+        if (opts->batch > 0) {
+            outs[0] = out + pos * 2;
+            for (int k = 1; k < count; k++) outs[k] = batch_out[k - 1];
+            move_plugin_render_batch_v2(insts, outs, count, frames);
+        } else {
+            api->render_block(insts[0], out + pos * 2, frames);
+        }
+
+        window_frames += frames;
+        if (window_frames >= WINDOW_FRAMES) {
+            double t = now_seconds();
+            double ns = (t - window_start) * 1e9 / window_frames / count;
+            if (ns > *worst_ns) *worst_ns = ns;
+            window_start = t;
+            window_frames = 0;
+        }
+    }
+
+    elapsed = (now_seconds() - t0) / count;
+    for (int k = 0; k < count; k++) api->destroy_instance(insts[k]);
+    return elapsed;
+}
+
+static void measure_levels(const int16_t *out, int frames, render_result_t *res) {
+    double sum = 0.0;
+    int peak = 0;
+    for (int i = 0; i < frames; i++) {
+        int s = out[i * 2];
+        sum += (double)s * s;
+        if (abs(s) > peak) peak = abs(s);
+    }
+    double rms = sqrt(sum / (frames > 0 ? frames : 1)) / 32768.0;
+    res->rms = (rms > 0.0) ? 20.0 * log10(rms) : -INFINITY;
+    res->peak = (peak > 0) ? 20.0 * log10(peak / 32768.0) : -INFINITY;
+}
+
+static void file_safe_name(const char *name, char *out, int out_len) {
+    int j = 0;
+    for (int i = 0; name[i] && j < out_len - 1; i++) {
+        char c = name[i];
+        int ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                 (c >= '0' && c <= '9') || c == '-' || c == '_';
+        out[j++] = ok ? c : '_';
+    }
+    out[j] = '\0';
+}
+
+/* =====================================================================
+ * Golden output
+ * A golden directory holds golden.txt, which records the render setup and
+ * one line per preset with the output hash and averaged band spectrum,
+ * plus NN.raw with the reference mono int16 render for SNR checks.
+ * References depend on compiler and architecture, so record them from a
+ * known-good build on the same machine before changing the engine.
+ * ===================================================================== */
+
+#define GOLDEN_FILE "golden.txt"
+#define GOLDEN_BANDS 24
+#define GOLDEN_FFT 8192
+#define GOLDEN_FLOOR_DB -100.0    /* Bands below this are ignored */
+#define MAX_GOLDEN 64
+#define GOLDEN_SETTINGS_MAX 512
+
+typedef struct {
+    int preset;
+    uint64_t hash;
+    float bands[GOLDEN_BANDS];    /* Average band power, dBFS */
+} golden_entry_t;
+
+typedef struct {
+    int frames;
+    int block;
+    char settings[GOLDEN_SETTINGS_MAX];  /* "key=val" list joined with spaces */
+    golden_entry_t entries[MAX_GOLDEN];
+    int count;
+} golden_t;
+
+/* FNV-1a over the left channel */
+static uint64_t output_hash(const int16_t *out, int frames) {
+    uint64_t h = 1469598103934665603ULL;
+    for (int i = 0; i < frames; i++) {
+        uint16_t s = (uint16_t)out[i * 2];
+        h = (h ^ (s & 0xFF)) * 1099511628211ULL;
+        h = (h ^ (s >> 8)) * 1099511628211ULL;
+    }
+    return h;
+}
+
+/* In-place radix-2 complex FFT */
+static void fft(double *re, double *im, int n) {
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            double t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        double ang = -2.0 * M_PI / len;
+        for (int i = 0; i < n; i += len) {
+            for (int k = 0; k < len / 2; k++) {
+                double wr = cos(ang * k), wi = sin(ang * k);
+                double *ar = &re[i + k], *ai = &im[i + k];
+                double *br = &re[i + k + len / 2], *bi = &im[i + k + len / 2];
+                double tr = *br * wr - *bi * wi;
+                double ti = *br * wi + *bi * wr;
+                *br = *ar - tr; *bi = *ai - ti;
+                *ar += tr; *ai += ti;
+            }
+        }
+    }
+}
+
+/* Power averaged over Hann-windowed, half-overlapped frames and summed
+ * into log-spaced bands from 20 Hz to 20 kHz */
+static void band_spectrum(const int16_t *out, int frames, float *bands) {
+    static double re[GOLDEN_FFT], im[GOLDEN_FFT], power[GOLDEN_FFT / 2];
+    memset(power, 0, sizeof(power));
+    int windows = 0;
+
+    for (int pos = 0; pos + GOLDEN_FFT <= frames; pos += GOLDEN_FFT / 2) {
+        for (int i = 0; i < GOLDEN_FFT; i++) {
+            double w = 0.5 - 0.5 * cos(2.0 * M_PI * i / GOLDEN_FFT);
+            re[i] = out[(pos + i) * 2] / 32768.0 * w;
+            im[i] = 0.0;
+        }
+        fft(re, im, GOLDEN_FFT);
+        for (int k = 0; k < GOLDEN_FFT / 2; k++) power[k] += re[k] * re[k] + im[k] * im[k];
+        windows++;
+    }
+
+    /* Normalized so a full-scale sine reads about 0 dB */
+    double norm = (windows > 0) ? 1.0 / (windows * (GOLDEN_FFT / 4.0) * (GOLDEN_FFT / 4.0)) : 0.0;
+    for (int b = 0; b < GOLDEN_BANDS; b++) {
+        double lo = 20.0 * pow(1000.0, (double)b / GOLDEN_BANDS);
+        double hi = 20.0 * pow(1000.0, (double)(b + 1) / GOLDEN_BANDS);
+        double sum = 0.0;
+        for (int k = 1; k < GOLDEN_FFT / 2; k++) {
+            double hz = (double)k * SAMPLE_RATE / GOLDEN_FFT;
+            if (hz >= lo && hz < hi) sum += power[k];
+        }
+        double db = 10.0 * log10(sum * norm + 1e-20);
+        bands[b] = (float)(db < -200.0 ? -200.0 : db);
+    }
+}
+
+static void golden_settings(const render_opts_t *opts, char *buf, int buf_len) {
+    buf[0] = '\0';
+    for (int i = 0; i < opts->setting_count; i++) {
+        int len = (int)strlen(buf);
+        snprintf(buf + len, buf_len - len, "%s%s", i ? " " : "", opts->settings[i]);
+    }
+}
+
+static int golden_load(const char *dir, golden_t *g) {
+    char path[512], line[1024];
+    snprintf(path, sizeof(path), "%s/" GOLDEN_FILE, dir);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    memset(g, 0, sizeof(*g));
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strncmp(line, "frames ", 7) == 0) {
+            g->frames = atoi(line + 7);
+        } else if (strncmp(line, "block ", 6) == 0) {
+            g->block = atoi(line + 6);
+        } else if (strncmp(line, "set ", 4) == 0) {
+            size_t len = strlen(line + 4);
+            if (len >= sizeof(g->settings)) {
+                fclose(f);
+                return -1;
+            }
+            memcpy(g->settings, line + 4, len + 1);
+        } else if (strncmp(line, "preset ", 7) == 0 && g->count < MAX_GOLDEN) {
+            golden_entry_t *e = &g->entries[g->count];
+            unsigned long long hash;
+            int used = 0;
+            if (sscanf(line + 7, "%d %llx%n", &e->preset, &hash, &used) < 2) continue;
+            e->hash = hash;
+            char *p = line + 7 + used;
+            for (int b = 0; b < GOLDEN_BANDS; b++) e->bands[b] = strtof(p, &p);
+            g->count++;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static const golden_entry_t *golden_find(const golden_t *g, int preset) {
+    for (int i = 0; i < g->count; i++) {
+        if (g->entries[i].preset == preset) return &g->entries[i];
+    }
+    return NULL;
+}
+
+/* mkdir -p; returns 0 if dir exists afterwards */
+static int make_dirs(const char *dir) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s", dir);
+    for (char *p = path + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) return -1;
+        *p = '/';
+    }
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) return -1;
+    return 0;
+}
+
+/* Mono int16 reference render */
+static int golden_write_raw(const char *dir, int preset, const int16_t *out, int frames) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%02d.raw", dir, preset);
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    for (int i = 0; i < frames; i++) put_le(f, (uint16_t)out[i * 2], 2);
+    int err = ferror(f);
+    fclose(f);
+    return err ? -1 : 0;
+}
+
+/* Time-domain SNR of out against the reference render, in dB; NAN if the
+ * reference has no raw render (golden.txt alone supports --spectral) */
+static double golden_snr(const char *dir, int preset, const int16_t *out, int frames) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%02d.raw", dir, preset);
+    FILE *f = fopen(path, "rb");
+    if (!f) return NAN;
+
+    double signal = 0.0, noise = 0.0;
+    int i = 0;
+    int lo, hi;
+    while (i < frames && (lo = fgetc(f)) != EOF && (hi = fgetc(f)) != EOF) {
+        double ref = (int16_t)(uint16_t)(lo | (hi << 8));
+        double d = out[i * 2] - ref;
+        signal += ref * ref;
+        noise += d * d;
+        i++;
+    }
+    fclose(f);
+
+    if (i < frames) return -INFINITY;
+    if (noise == 0.0) return INFINITY;
+    if (signal == 0.0) return -INFINITY;
+    return 10.0 * log10(signal / noise);
+}
+
+/* Largest band difference in dB, skipping bands quiet in both */
+static double golden_spectral_dev(const float *ref, const float *bands) {
+    double dev = 0.0;
+    for (int b = 0; b < GOLDEN_BANDS; b++) {
+        if (ref[b] < GOLDEN_FLOOR_DB && bands[b] < GOLDEN_FLOOR_DB) continue;
+        double d = fabs((double)ref[b] - bands[b]);
+        if (d > dev) dev = d;
+    }
+    return dev;
+}
+
+/* =====================================================================
+ * Filter coefficient table check
+ * ===================================================================== */
+
+/* Largest allowed table error: f and gain relative, feedback absolute */
+#define FILTER_TOL_F     2e-3f
+#define FILTER_TOL_GAIN  1e-2f
+#define FILTER_TOL_FB    1e-5f
+#define FILTER_STEPS     64    /* Cutoffs per table interval */
+
+/* Returns: process exit status */
+static int filter_check(void) {
+    static const char *const os_names[MOOG_FILTER_OS_COUNT] = { "1x", "2x", "4x" };
+
+    moog_engine_tables_init();
+    printf("filter table vs exact, %d cutoffs per interval; tolerance f %.1e, gain %.1e, fb %.1e\n",
+           FILTER_STEPS, FILTER_TOL_F, FILTER_TOL_GAIN, FILTER_TOL_FB);
+    printf("%-3s %9s %10s %10s %10s  %s\n", "os", "resonance", "f err", "gain err", "fb err", "result");
+
+    int failures = 0;
+    for (int os = 0; os < MOOG_FILTER_OS_COUNT; os++) {
+        for (int r = 0; r <= 4; r++) {
+            float resonance = r * 0.25f;
+            moog_filter_table_error_t err;
+            moog_engine_filter_table_error(os, resonance, FILTER_STEPS, &err);
+
+            int ok = err.f <= FILTER_TOL_F && err.gain <= FILTER_TOL_GAIN && err.fb <= FILTER_TOL_FB;
+            if (!ok) failures++;
+            printf("%-3s %9.2f %10.2e %10.2e %10.2e  %s\n", os_names[os], resonance,
+                   err.f, err.gain, err.fb, ok ? "ok" : "FAIL");
+        }
+    }
+
+    if (failures) {
+        printf("filter check: %d of %d sweeps out of tolerance\n", failures, MOOG_FILTER_OS_COUNT * 5);
+        return 1;
+    }
+    printf("filter check: all sweeps within tolerance\n");
+    return 0;
+}
+
+/* =====================================================================
+ * Main
+ * ===================================================================== */
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -p, --preset N      Render only factory preset N (default: all)\n"
+        "  -s, --script FILE   Note script (default: built-in script)\n"
+        "  -o, --out DIR       Write DIR/NN_Name.wav per preset\n"
+        "  -r, --repeat N      Timed passes per preset, best is reported (default 3)\n"
+        "  -b, --block N       Frames per render_block call (1-%d, default 128)\n"
+        "  --set KEY=VAL       Set a param after loading the preset (repeatable)\n"
+        "  --tail SEC          Held decay plus long release tail benchmark\n"
+        "  --voices N          Polyphony benchmark: N-note chord, cost per voice\n"
+        "  --batch N           Render N instances together, timing per instance\n"
+        "  --golden-write DIR  Record reference renders into DIR\n"
+        "  --golden-check DIR  Compare renders against DIR, exit 1 on mismatch\n"
+        "  --snr DB            Accept time-domain SNR >= DB instead of bit-exact\n"
+        "  --spectral DB       Accept band spectrum deviation <= DB instead of bit-exact\n"
+        "  --filter-check      Check the filter coefficient table against the exact path\n",
+        prog, MAX_BLOCK);
+}
+
+int main(int argc, char **argv) {
+    int preset = -1;
+    int repeat = 3;
+    const char *script_path = NULL;
+    const char *out_dir = NULL;
+    const char *golden_write_dir = NULL;
+    const char *golden_check_dir = NULL;
+    double min_snr = NAN;
+    double max_spectral = NAN;
+    double tail_seconds = 0.0;
+    int voices = 0;
+    render_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.block = 128;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *next = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if ((strcmp(arg, "-p") == 0 || strcmp(arg, "--preset") == 0) && next) {
+            preset = atoi(next); i++;
+        } else if ((strcmp(arg, "-s") == 0 || strcmp(arg, "--script") == 0) && next) {
+            script_path = next; i++;
+        } else if ((strcmp(arg, "-o") == 0 || strcmp(arg, "--out") == 0) && next) {
+            out_dir = next; i++;
+        } else if ((strcmp(arg, "-r") == 0 || strcmp(arg, "--repeat") == 0) && next) {
+            repeat = atoi(next); i++;
+        } else if ((strcmp(arg, "-b") == 0 || strcmp(arg, "--block") == 0) && next) {
+            opts.block = atoi(next); i++;
+        } else if (strcmp(arg, "--set") == 0 && next && strchr(next, '=')) {
+            if (opts.setting_count == MAX_SETTINGS) {
+                fprintf(stderr, "too many --set options\n");
+                return 1;
+            }
+            opts.settings[opts.setting_count++] = next; i++;
+        } else if (strcmp(arg, "--tail") == 0 && next) {
+            tail_seconds = atof(next); i++;
+        } else if (strcmp(arg, "--voices") == 0 && next) {
+            voices = atoi(next); i++;
+        } else if (strcmp(arg, "--batch") == 0 && next) {
+            opts.batch = atoi(next); i++;
+        } else if (strcmp(arg, "--golden-write") == 0 && next) {
+            golden_write_dir = next; i++;
+        } else if (strcmp(arg, "--golden-check") == 0 && next) {
+            golden_check_dir = next; i++;
+        } else if (strcmp(arg, "--snr") == 0 && next) {
+            min_snr = atof(next); i++;
+        } else if (strcmp(arg, "--spectral") == 0 && next) {
+            max_spectral = atof(next); i++;
+        } else if (strcmp(arg, "--filter-check") == 0) {
+            return filter_check();
+        } else {
+            usage(argv[0]);
+            return (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) ? 0 : 1;
+        }
+    }
+
+    if (repeat < 1) repeat = 1;
+    if (opts.block < 1 || opts.block > MAX_BLOCK) {
+        fprintf(stderr, "block size must be 1-%d\n", MAX_BLOCK);
+        return 1;
+    }
+    if (opts.batch < 0 || opts.batch > MAX_BATCH) {
+        fprintf(stderr, "--batch must be 1-%d\n", MAX_BATCH);
+        return 1;
+    }
+    if (golden_write_dir && golden_check_dir) {
+        fprintf(stderr, "--golden-write and --golden-check are exclusive\n");
+        return 1;
+    }
+
+    /* Tail benchmark: its envelope overrides go first so --set still wins */
+    char tail_script[128];
+    if (tail_seconds > 0.0) {
+        static const char *tail_settings[] = {
+            "sustain=0", "f_sustain=0", "release=1", "f_release=1"
+        };
+        const int n = sizeof(tail_settings) / sizeof(tail_settings[0]);
+        if (script_path || opts.setting_count + n > MAX_SETTINGS) {
+            fprintf(stderr, "--tail cannot be combined with --script\n");
+            return 1;
+        }
+        memmove(opts.settings + n, opts.settings, opts.setting_count * sizeof(opts.settings[0]));
+        for (int i = 0; i < n; i++) opts.settings[i] = tail_settings[i];
+        opts.setting_count += n;
+
+        double ms = tail_seconds * 1000.0;
+        snprintf(tail_script, sizeof(tail_script), "0 on 36 100\n%.0f off 36\n%.0f end\n",
+                 ms / 2.0, ms);
+    }
+
+    /* Polyphony benchmark: a chord with one note per voice */
+    char voices_script[512];
+    char voices_setting[32];
+    if (voices > 0) {
+        static const int chord[] = { 48, 52, 55, 59, 62, 65, 69, 72 };
+        const int max_voices = sizeof(chord) / sizeof(chord[0]);
+        if (voices > max_voices) {
+            fprintf(stderr, "--voices must be 1-%d\n", max_voices);
+            return 1;
+        }
+        if (script_path || tail_seconds > 0.0 || opts.setting_count == MAX_SETTINGS) {
+            fprintf(stderr, "--voices cannot be combined with --script or --tail\n");
+            return 1;
+        }
+        snprintf(voices_setting, sizeof(voices_setting), "polyphony=%d", voices);
+        memmove(opts.settings + 1, opts.settings, opts.setting_count * sizeof(opts.settings[0]));
+        opts.settings[0] = voices_setting;
+        opts.setting_count++;
+
+        int len = 0;
+        for (int v = 0; v < voices; v++) {
+            len += snprintf(voices_script + len, sizeof(voices_script) - len, "0 on %d 100\n", chord[v]);
+        }
+        for (int v = 0; v < voices; v++) {
+            len += snprintf(voices_script + len, sizeof(voices_script) - len, "2000 off %d\n", chord[v]);
+        }
+        snprintf(voices_script + len, sizeof(voices_script) - len, "3000 end\n");
+    }
+
+    note_script_t script;
+    char *text = NULL;
+    if (script_path) {
+        text = read_file(script_path);
+        if (!text) {
+            fprintf(stderr, "cannot read %s\n", script_path);
+            return 1;
+        }
+    }
+    int err = script_parse(&script, text ? text :
+                           (tail_seconds > 0.0) ? tail_script :
+                           (voices > 0) ? voices_script : g_default_script);
+    free(text);
+    if (err) return 1;
+
+    host_api_v1_t host;
+    memset(&host, 0, sizeof(host));
+    host.api_version = 1;
+    host.sample_rate = SAMPLE_RATE;
+    host.frames_per_block = opts.block;
+
+    plugin_api_v2_t *api = move_plugin_init_v2(&host);
+    if (!api) {
+        fprintf(stderr, "plugin init failed\n");
+        return 1;
+    }
+
+    /* Preset count from a scratch instance */
+    int preset_count = 0;
+    void *probe = api->create_instance(".", "");
+    if (probe) {
+        char buf[16];
+        if (api->get_param(probe, "preset_count", buf, sizeof(buf)) > 0) preset_count = atoi(buf);
+        api->destroy_instance(probe);
+    }
+    if (preset >= preset_count) {
+        fprintf(stderr, "preset %d out of range (0-%d)\n", preset, preset_count - 1);
+        return 1;
+    }
+    int first = (preset >= 0) ? preset : 0;
+    int last = (preset >= 0) ? preset : preset_count - 1;
+
+    /* Golden setup: the reference must come from the same script,
+     * block size and settings */
+    char settings[GOLDEN_SETTINGS_MAX];
+    golden_settings(&opts, settings, sizeof(settings));
+    static golden_t golden;
+    FILE *golden_out = NULL;
+    int exact = isnan(min_snr) && isnan(max_spectral);
+
+    if (golden_check_dir) {
+        if (golden_load(golden_check_dir, &golden) != 0) {
+            fprintf(stderr, "cannot load %s/" GOLDEN_FILE "\n", golden_check_dir);
+            return 1;
+        }
+        if (golden.frames != script.length || golden.block != opts.block ||
+            strcmp(golden.settings, settings) != 0) {
+            fprintf(stderr, "golden setup differs: recorded %d frames, block %d, set \"%s\"\n",
+                    golden.frames, golden.block, golden.settings);
+            return 1;
+        }
+    }
+    if (golden_write_dir) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/" GOLDEN_FILE, golden_write_dir);
+        golden_out = (make_dirs(golden_write_dir) == 0) ? fopen(path, "w") : NULL;
+        if (!golden_out) {
+            fprintf(stderr, "cannot write %s\n", path);
+            return 1;
+        }
+        fprintf(golden_out, "# moog_render golden output\n");
+        fprintf(golden_out, "frames %d\nblock %d\n", script.length, opts.block);
+        if (settings[0]) fprintf(golden_out, "set %s\n", settings);
+    }
+
+    int16_t *out = (int16_t*)malloc((size_t)script.length * 2 * sizeof(int16_t));
+    if (!out) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    printf("%d frames (%.2f s) per preset, block %d, best of %d\n",
+           script.length, (double)script.length / SAMPLE_RATE, opts.block, repeat);
+    if (opts.batch > 0) printf("batch of %d instances, timing per instance\n", opts.batch);
+    for (int i = 0; i < opts.setting_count; i++) printf("set %s\n", opts.settings[i]);
+    printf("%-3s %-16s %10s %10s %9s %9s %9s", "#", "preset", "ns/sample", "realtime", "worst ns",
+           "rms dB", "peak dB");
+    if (voices > 0) printf(" %9s %7s", "ns/voice", "% core");
+    if (golden_check_dir) printf(" %8s %8s  %s", "snr dB", "spec dB", "golden");
+    printf("\n");
+
+    double total_ns = 0.0;
+    double worst_ns = 0.0;
+    int rendered = 0;
+    int failures = 0;
+
+    for (int p = first; p <= last; p++) {
+        render_result_t res;
+        memset(&res, 0, sizeof(res));
+        res.ns_per_sample = INFINITY;
+
+        for (int r = 0; r < repeat; r++) {
+            double worst;
+            double secs = render_pass(api, p, &script, &opts, out,
+                                      r == 0 ? res.name : NULL, sizeof(res.name), &worst);
+            if (secs < 0.0) {
+                fprintf(stderr, "create_instance failed\n");
+                free(out);
+                return 1;
+            }
+            double ns = secs * 1e9 / script.length;
+            if (ns < res.ns_per_sample) {
+                res.ns_per_sample = ns;
+                res.worst_ns = worst;
+            }
+        }
+
+        measure_levels(out, script.length, &res);
+        double realtime = (1e9 / SAMPLE_RATE) / res.ns_per_sample;
+        printf("%-3d %-16s %10.1f %9.0fx %9.1f %9.1f %9.1f",
+               p, res.name, res.ns_per_sample, realtime, res.worst_ns, res.rms, res.peak);
+        if (voices > 0) {
+            double per_voice = res.ns_per_sample / voices;
+            printf(" %9.1f %6.2f%%", per_voice, per_voice * SAMPLE_RATE * 1e-7);
+        }
+
+        if (golden_out || golden_check_dir) {
+            uint64_t hash = output_hash(out, script.length);
+            float bands[GOLDEN_BANDS];
+            band_spectrum(out, script.length, bands);
+
+            if (golden_out) {
+                fprintf(golden_out, "preset %d %016llx", p, (unsigned long long)hash);
+                for (int b = 0; b < GOLDEN_BANDS; b++) fprintf(golden_out, " %.3f", bands[b]);
+                fprintf(golden_out, " %s\n", res.name);
+                if (golden_write_raw(golden_write_dir, p, out, script.length) != 0) {
+                    fprintf(stderr, "cannot write reference render for preset %d\n", p);
+                }
+            } else {
+                const golden_entry_t *ref = golden_find(&golden, p);
+                const char *status;
+                if (!ref) {
+                    printf(" %8s %8s  %s", "-", "-", "MISSING");
+                    failures++;
+                } else {
+                    int identical = (ref->hash == hash);
+                    double snr = identical ? INFINITY : golden_snr(golden_check_dir, p, out, script.length);
+                    double dev = golden_spectral_dev(ref->bands, bands);
+                    int pass;
+                    if (identical) {
+                        pass = 1;
+                        status = "exact";
+                    } else {
+                        pass = !exact;
+                        if (!isnan(min_snr) && !(snr >= min_snr)) pass = 0;
+                        if (!isnan(max_spectral) && !(dev <= max_spectral)) pass = 0;
+                        status = pass ? "ok" : "FAIL";
+                    }
+                    if (isnan(snr)) printf(" %8s", "-");
+                    else printf(" %8.1f", snr);
+                    printf(" %8.2f  %s", dev, status);
+                    if (!pass) failures++;
+                }
+            }
+        }
+        printf("\n");
+
+        if (out_dir) {
+            char safe[64], path[512];
+            file_safe_name(res.name, safe, sizeof(safe));
+            snprintf(path, sizeof(path), "%s/%02d_%s.wav", out_dir, p, safe);
+            if (write_wav(path, out, script.length) != 0) {
+                fprintf(stderr, "cannot write %s\n", path);
+            }
+        }
+
+        total_ns += res.ns_per_sample;
+        if (res.worst_ns > worst_ns) worst_ns = res.worst_ns;
+        rendered++;
+    }
+
+    if (rendered > 1) {
+        double avg = total_ns / rendered;
+        printf("%-3s %-16s %10.1f %9.0fx %9.1f", "", "average", avg, (1e9 / SAMPLE_RATE) / avg,
+               worst_ns);
+        if (voices > 0) {
+            double per_voice = avg / voices;
+            printf(" %9s %9s %9.1f %6.2f%%", "", "", per_voice, per_voice * SAMPLE_RATE * 1e-7);
+        }
+        printf("\n");
+    }
+
+    if (golden_out) {
+        fclose(golden_out);
+        printf("golden output written to %s\n", golden_write_dir);
+    }
+    if (golden_check_dir) {
+        if (failures) {
+            printf("golden check: %d of %d presets failed\n", failures, rendered);
+        } else {
+            printf("golden check: all %d presets passed (%s)\n", rendered,
+                   exact ? "bit-exact" : "within tolerance");
+        }
+    }
+
+    free(out);
+    free(script.events);
+    return failures ? 1 : 0;
+}